@@ -0,0 +1,16 @@
+# Writes the SPIR-V binary SPIRV to HEADER as a constexpr array of words named NAME.
+# Run with cmake -DSPIRV=... -DHEADER=... -DNAME=... -P embedspirv.cmake
+
+file(READ ${SPIRV} hex HEX)
+string(LENGTH "${hex}" length)
+math(EXPR remainder "${length} % 8")
+if (length EQUAL 0 OR NOT remainder EQUAL 0)
+    message(FATAL_ERROR "${SPIRV} is not a SPIR-V binary")
+endif()
+
+# the bytes are in file order and glslangValidator writes little endian words
+string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1," words "${hex}")
+string(REGEX REPLACE "(0x........,0x........,0x........,0x........,0x........,0x........,0x........,0x........,)" "\\1\n    " words "${words}")
+string(STRIP "${words}" words)
+
+file(WRITE ${HEADER} "// generated from ${SPIRV}, do not edit\n\n#pragma once\n\n#include <cstdint>\n\ninline constexpr uint32_t ${NAME}[] = {\n    ${words}\n};\n")
@@ -0,0 +1,206 @@
+#include "vallocator.h"
+#include "vbuffer.h"
+#include "vcommandbuffer.h"
+#include "vcommandpool.h"
+#include "vdefragmenter.h"
+#include "vdevice.h"
+#include "vfence.h"
+#include "vhostallocator.h"
+#include "vuploader.h"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+// Stress test for the device memory sub-allocator: creates, binds and frees tens of
+// thousands of buffers of assorted sizes in random order, then defragments what is left.
+
+namespace {
+
+std::unique_ptr<V::Buffer> createBuffer(const V::Device *device, VkDeviceSize size)
+{
+    // the defragmenter moves buffers with transfers
+    return device->createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, V::MemoryUsage::GpuOnly);
+}
+
+// allocations are aligned, disjoint within their block and add up to the allocator's statistics
+void checkAllocations(const V::Device *device, const std::vector<std::unique_ptr<V::Buffer>> &buffers)
+{
+    std::map<const V::MemoryBlock *, std::vector<const V::Allocation *>> blockAllocations;
+    VkDeviceSize allocationBytes = 0;
+    for (const auto &buffer : buffers) {
+        const auto *allocation = buffer->allocation();
+        const VkMemoryRequirements requirements = device->bufferMemoryRequirements(buffer.get());
+        if (allocation->offset() % requirements.alignment != 0)
+            throw std::runtime_error("Misaligned allocation");
+        if (allocation->size() < requirements.size)
+            throw std::runtime_error("Allocation smaller than its buffer");
+        blockAllocations[allocation->block()].push_back(allocation);
+        allocationBytes += allocation->size();
+    }
+
+    for (auto &entry : blockAllocations) {
+        auto &allocations = entry.second;
+        std::sort(allocations.begin(), allocations.end(), [](const V::Allocation *a, const V::Allocation *b) {
+            return a->offset() < b->offset();
+        });
+        for (size_t i = 1; i < allocations.size(); ++i) {
+            if (allocations[i - 1]->offset() + allocations[i - 1]->size() > allocations[i]->offset())
+                throw std::runtime_error("Overlapping allocations");
+        }
+        if (allocations.back()->offset() + allocations.back()->size() > entry.first->size())
+            throw std::runtime_error("Allocation past the end of its block");
+    }
+
+    const auto statistics = device->memoryStatistics();
+    if (statistics.total.allocationCount != buffers.size() || statistics.total.allocationBytes != allocationBytes)
+        throw std::runtime_error("Memory statistics do not match the live buffers");
+}
+
+uint32_t patternWord(size_t bufferIndex, size_t wordIndex)
+{
+    return static_cast<uint32_t>(bufferIndex * 7919 + wordIndex);
+}
+
+} // namespace
+
+int main()
+{
+    // about 100 MB live at a time, sizes are multiples of 4 so that they hold a whole pattern
+    constexpr int BufferCount = 50000;
+    constexpr int Iterations = 4;
+
+    glfwInit();
+
+    {
+        V::Device device;
+
+        std::mt19937 rng(1234);
+        std::uniform_int_distribution<VkDeviceSize> sizeDistribution(4, 1024);
+        const auto randomSize = [&] { return 4 * sizeDistribution(rng); };
+
+        std::vector<std::unique_ptr<V::Buffer>> buffers;
+        buffers.reserve(BufferCount);
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < BufferCount; ++i)
+            buffers.push_back(createBuffer(&device, randomSize()));
+
+        for (int iteration = 0; iteration < Iterations; ++iteration) {
+            // free a random half of the buffers, then fill the holes with buffers of different sizes
+            std::shuffle(buffers.begin(), buffers.end(), rng);
+            buffers.resize(BufferCount / 2);
+            for (int i = BufferCount / 2; i < BufferCount; ++i)
+                buffers.push_back(createBuffer(&device, randomSize()));
+        }
+
+        const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+        checkAllocations(&device, buffers);
+
+        // fragmentation after the churn, before everything is released
+        std::cout << device.memoryStatistics().toJson() << '\n';
+        std::cout << "Created and freed " << BufferCount + Iterations * BufferCount / 2 << " buffers in " << elapsed.count() << " ms\n";
+
+        // drop most buffers and give the survivors contents that must survive being moved
+        buffers.resize(BufferCount / 10);
+        {
+            V::Uploader uploader(&device);
+            for (size_t i = 0; i < buffers.size(); ++i) {
+                std::vector<uint32_t> pattern(buffers[i]->size() / sizeof(uint32_t));
+                for (size_t j = 0; j < pattern.size(); ++j)
+                    pattern[j] = patternWord(i, j);
+                uploader.upload(buffers[i].get(), 0, pattern.data(), buffers[i]->size());
+            }
+            uploader.wait(uploader.submit());
+        }
+
+        // blocks emptied by the frees don't count, only those emptied by moving buffers
+        device.allocator()->releaseEmptyBlocks();
+        const size_t startBlockCount = device.memoryStatistics().total.blockCount;
+
+        // compact the survivors, a few milliseconds at a time
+        V::Defragmenter defragmenter(&device);
+        int stepCount = 0;
+        do {
+            defragmenter.step(std::chrono::milliseconds(2));
+            ++stepCount;
+        } while (!defragmenter.isFinished());
+
+        const auto statistics = device.memoryStatistics();
+        std::cout << "Defragmented in " << stepCount << " steps: moved " << defragmenter.movedBufferCount() << " buffers, released " << defragmenter.releasedBlockCount() << " blocks, " << statistics.total.blockCount << " blocks left\n";
+        std::cout << statistics.toJson() << '\n';
+        if (defragmenter.releasedBlockCount() == 0 || statistics.total.blockCount >= startBlockCount)
+            throw std::runtime_error("Defragmenting released no blocks");
+        checkAllocations(&device, buffers);
+
+        // read every survivor back, to check the moves kept the contents
+        {
+            VkDeviceSize readbackSize = 0;
+            for (const auto &buffer : buffers)
+                readbackSize += buffer->size();
+            auto readbackBuffer = device.createBuffer(readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, V::MemoryUsage::Readback);
+
+            auto commandPool = device.createCommandPool();
+            auto commandBuffer = commandPool->allocateCommandBuffer();
+            commandBuffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+            VkDeviceSize offset = 0;
+            for (const auto &buffer : buffers) {
+                VkBufferCopy region = {
+                    .srcOffset = 0,
+                    .dstOffset = offset,
+                    .size = buffer->size()
+                };
+                commandBuffer->copyBuffer(buffer.get(), readbackBuffer.get(), { region });
+                offset += buffer->size();
+            }
+            commandBuffer->memoryBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+            commandBuffer->end();
+
+            auto fence = device.createFence();
+            const VkCommandBuffer commandBufferHandle = commandBuffer->handle();
+            VkSubmitInfo submitInfo = {
+                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                .commandBufferCount = 1,
+                .pCommandBuffers = &commandBufferHandle
+            };
+            if (vkQueueSubmit(device.queue(), 1, &submitInfo, fence->handle()) != VK_SUCCESS)
+                throw std::runtime_error("Failed to submit command");
+            fence->wait();
+
+            readbackBuffer->allocation()->invalidate();
+            device.invalidateMappedMemoryRanges();
+            const auto *result = readbackBuffer->allocation()->map<const uint32_t>();
+            for (size_t i = 0; i < buffers.size(); ++i) {
+                for (size_t j = 0; j < buffers[i]->size() / sizeof(uint32_t); ++j) {
+                    if (*result++ != patternWord(i, j))
+                        throw std::runtime_error("Moved buffer lost its contents");
+                }
+            }
+        }
+
+        // large buffers bypass the shared blocks and are released with the buffer
+        auto largeBuffer = createBuffer(&device, 48 * 1024 * 1024);
+        std::cout << "Dedicated blocks with a 48 MiB buffer alive: " << device.memoryStatistics().total.dedicatedBlockCount << '\n';
+        largeBuffer.reset();
+        std::cout << "Dedicated blocks after releasing it: " << device.memoryStatistics().total.dedicatedBlockCount << '\n';
+
+        buffers.clear();
+
+        const auto finalStatistics = device.memoryStatistics();
+        if (finalStatistics.total.allocationCount != 0 || finalStatistics.total.allocationBytes != 0 || finalStatistics.total.dedicatedBlockCount != 0)
+            throw std::runtime_error("Memory still allocated after releasing every buffer");
+
+        std::cout << "Driver host allocations: " << device.hostAllocator()->statistics().toJson() << '\n';
+    }
+
+    glfwTerminate();
+}
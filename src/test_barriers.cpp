@@ -0,0 +1,134 @@
+#include "vallocator.h"
+#include "vbarrierbatch.h"
+#include "vbuffer.h"
+#include "vcommandbuffer.h"
+#include "vcommandpool.h"
+#include "vdevice.h"
+#include "vfence.h"
+#include "vuploader.h"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// Records a chain of copy passes ping-ponging between two sets of buffers, declaring every
+// access to a BarrierBatch, and compares the barriers it records with one barrier per access.
+// The result of the chain is copied into Readback memory and checked on the CPU.
+
+namespace {
+
+void printStatistics(const char *name, const V::BarrierBatch::Statistics &statistics)
+{
+    std::cout << name << ": " << statistics.accesses << " accesses, " << statistics.skipped << " without barrier, " << statistics.pipelineBarriers << " vkCmdPipelineBarrier calls with " << statistics.bufferBarriers << " buffer barriers";
+    if (statistics.overSynchronized)
+        std::cout << ", " << statistics.overSynchronized << " over-synchronized";
+    std::cout << '\n';
+}
+
+} // namespace
+
+int main()
+{
+    constexpr int BufferCount = 16;
+    constexpr int PassCount = 8;
+    constexpr VkDeviceSize BufferSize = 64 * 1024;
+
+    glfwInit();
+
+    {
+        V::Device device;
+        auto commandPool = device.createCommandPool();
+        auto commandBuffer = commandPool->allocateCommandBuffer();
+
+        std::array<std::vector<std::unique_ptr<V::Buffer>>, 2> buffers;
+        for (auto &bufferSet : buffers) {
+            for (int i = 0; i < BufferCount; ++i)
+                bufferSet.push_back(device.createBuffer(BufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, V::MemoryUsage::GpuOnly));
+        }
+
+        // after an even number of passes the first set holds its initial contents again
+        std::vector<uint32_t> pattern(BufferSize / sizeof(uint32_t));
+        for (size_t i = 0; i < pattern.size(); ++i)
+            pattern[i] = static_cast<uint32_t>(i * 2654435761u);
+        {
+            V::Uploader uploader(&device);
+            uploader.upload(buffers[0][0].get(), 0, pattern.data(), BufferSize);
+            uploader.wait(uploader.submit());
+        }
+        static_assert(PassCount % 2 == 0);
+
+        V::BarrierBatch batch(true);
+        const VkBufferCopy region = { .srcOffset = 0, .dstOffset = 0, .size = BufferSize };
+
+        commandBuffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+        // the first pass needs no barrier, every later one a single barrier for all its copies
+        for (int pass = 0; pass < PassCount; ++pass) {
+            const auto &srcBuffers = buffers[pass % 2];
+            const auto &dstBuffers = buffers[(pass + 1) % 2];
+            for (int i = 0; i < BufferCount; ++i) {
+                batch.access(srcBuffers[i].get(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+                batch.access(dstBuffers[i].get(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+            }
+            batch.flush(commandBuffer.get());
+            for (int i = 0; i < BufferCount; ++i)
+                commandBuffer->copyBuffer(srcBuffers[i].get(), dstBuffers[i].get(), { region });
+        }
+
+        // read-after-read: only the first of two vertex input passes needs a barrier
+        for (int draw = 0; draw < 2; ++draw) {
+            for (const auto &buffer : buffers[PassCount % 2])
+                batch.access(buffer.get(), VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+            batch.flush(commandBuffer.get());
+        }
+
+        const auto statistics = batch.statistics();
+        printStatistics("Tracked", statistics);
+        std::cout << "One barrier per access would have taken " << statistics.accesses << " vkCmdPipelineBarrier calls\n";
+
+        // overwriting a vertex buffer waits for vertex input, while a vertex shader reading the other
+        // set waits for the copies that wrote it; merged into one barrier, each also waits for the other
+        V::BarrierBatch debugBatch(true);
+        const auto &vertexBuffers = buffers[PassCount % 2];
+        const auto &otherBuffers = buffers[(PassCount + 1) % 2];
+        debugBatch.access(vertexBuffers[0].get(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+        debugBatch.access(otherBuffers[0].get(), VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+        debugBatch.flush(commandBuffer.get());
+        printStatistics("Merged", debugBatch.statistics());
+
+        // read the result back through host cached memory, which needs an invalidate when it is not coherent
+        auto readbackBuffer = device.createBuffer(BufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, V::MemoryUsage::Readback);
+        batch.access(buffers[0][0].get(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+        batch.access(readbackBuffer.get(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+        batch.flush(commandBuffer.get());
+        commandBuffer->copyBuffer(buffers[0][0].get(), readbackBuffer.get(), { region });
+        commandBuffer->memoryBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+
+        commandBuffer->end();
+
+        auto fence = device.createFence();
+        const VkCommandBuffer commandBufferHandle = commandBuffer->handle();
+        VkSubmitInfo submitInfo = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &commandBufferHandle
+        };
+        if (vkQueueSubmit(device.queue(), 1, &submitInfo, fence->handle()) != VK_SUCCESS)
+            throw std::runtime_error("Failed to submit command");
+        fence->wait();
+
+        readbackBuffer->allocation()->invalidate();
+        device.invalidateMappedMemoryRanges();
+        const auto *result = readbackBuffer->allocation()->map<const uint32_t>();
+        if (!std::equal(pattern.begin(), pattern.end(), result))
+            throw std::runtime_error("Read back data does not match");
+        std::cout << "Read back " << BufferSize << " bytes after " << PassCount << " copy passes\n";
+    }
+
+    glfwTerminate();
+}
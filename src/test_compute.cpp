@@ -0,0 +1,338 @@
+#include "vallocator.h"
+#include "vbuffer.h"
+#include "vcommandbuffer.h"
+#include "vdescriptorpool.h"
+#include "vdescriptorset.h"
+#include "vdescriptorsetlayout.h"
+#include "vdevice.h"
+#include "vfence.h"
+#include "vhostallocator.h"
+#include "vpipeline.h"
+#include "vpipelinelayout.h"
+#include "vsemaphore.h"
+#include "vshadermodule.h"
+#include "vsurface.h"
+#include "vswapchain.h"
+#include "vthreadcommandpools.h"
+
+#include "shaders/test_compute_comp.h"
+#include "shaders/test_frag.h"
+#include "shaders/test_particles_vert.h"
+
+#include <GLFW/glfw3.h>
+
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// Particles animated by a compute shader and drawn with vertex pulling. The compute work is
+// submitted to the async compute queue when the device has one, and handed over to the
+// graphics queue with a semaphore and a queue family ownership transfer.
+
+namespace {
+
+// matches the push constant block of test_compute.comp
+struct ComputePushConstants {
+    float time;
+    uint32_t count;
+};
+
+} // namespace
+
+class VulkanRenderer : private NonCopyable
+{
+public:
+    explicit VulkanRenderer(GLFWwindow *window, int width, int height);
+    ~VulkanRenderer();
+
+    void render();
+    void dumpStatistics();
+
+private:
+    static constexpr uint32_t ParticleCount = 100000;
+    static constexpr uint32_t WorkgroupSize = 64;
+    static constexpr float ParticleSize = 0.004f;
+
+    GLFWwindow *m_window;
+    std::unique_ptr<V::Device> m_device;
+    std::unique_ptr<V::Surface> m_surface;
+    std::unique_ptr<V::Swapchain> m_swapchain;
+    std::unique_ptr<V::ShaderModule> m_computeShaderModule;
+    std::unique_ptr<V::ShaderModule> m_vertexShaderModule;
+    std::unique_ptr<V::ShaderModule> m_fragmentShaderModule;
+    std::unique_ptr<V::DescriptorSetLayout> m_descriptorSetLayout;
+    std::unique_ptr<V::DescriptorPool> m_descriptorPool;
+    std::unique_ptr<V::PipelineLayout> m_computePipelineLayout;
+    std::unique_ptr<V::Pipeline> m_computePipeline;
+    std::unique_ptr<V::PipelineLayout> m_pipelineLayout;
+    std::unique_ptr<V::Pipeline> m_pipeline;
+    std::unique_ptr<V::ThreadCommandPools> m_computeCommandPools;
+    std::unique_ptr<V::ThreadCommandPools> m_commandPools;
+    std::unique_ptr<V::Semaphore> m_imageAvailableSemaphore;
+    std::unique_ptr<V::Semaphore> m_computeFinishedSemaphore;
+    std::unique_ptr<V::Semaphore> m_renderFinishedSemaphore;
+    // one particle buffer per frame in flight, written by compute and read by the vertex shader
+    std::vector<std::unique_ptr<V::Buffer>> m_particleBuffers;
+    std::vector<std::unique_ptr<V::DescriptorSet>> m_descriptorSets;
+    std::vector<std::unique_ptr<V::Fence>> m_frameFences;
+};
+
+VulkanRenderer::VulkanRenderer(GLFWwindow *window, int width, int height)
+    : m_window(window)
+    , m_device(new V::Device(std::make_unique<V::HostAllocator>(), "pipeline_cache.bin"))
+    , m_surface(m_device->createSurface(window))
+    , m_swapchain(m_surface->createSwapchain(width, height, 3))
+    , m_computeShaderModule(m_device->createShaderModule(test_compute_comp))
+    , m_vertexShaderModule(m_device->createShaderModule(test_particles_vert))
+    , m_fragmentShaderModule(m_device->createShaderModule(test_frag))
+    , m_imageAvailableSemaphore(m_device->createSemaphore())
+    , m_computeFinishedSemaphore(m_device->createSemaphore())
+    , m_renderFinishedSemaphore(m_device->createSemaphore())
+{
+    const auto backbufferCount = m_swapchain->backbufferCount();
+
+    m_descriptorSetLayout = m_device->descriptorSetLayoutBuilder()
+                                    .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+                                    .create();
+
+    m_descriptorPool = m_device->descriptorPoolBuilder()
+                               .add(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, backbufferCount)
+                               .setMaxSets(backbufferCount)
+                               .create();
+
+    for (size_t i = 0; i < backbufferCount; ++i) {
+        m_particleBuffers.push_back(m_device->createBuffer(ParticleCount * 4 * sizeof(float), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, V::MemoryUsage::GpuOnly));
+        m_descriptorSets.push_back(m_descriptorPool->allocateDescriptorSet(m_descriptorSetLayout.get()));
+        m_descriptorSets.back()->writeBuffer(0, m_particleBuffers.back().get());
+    }
+
+    m_computePipelineLayout = m_device->pipelineLayoutBuilder()
+                                      .addSetLayout(m_descriptorSetLayout.get())
+                                      .addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants))
+                                      .create();
+
+    m_computePipeline = m_device->computePipelineBuilder()
+                                .setShader(m_computeShaderModule.get(), V::SpecializationConstants().set(0, WorkgroupSize))
+                                .create(m_computePipelineLayout.get());
+
+    m_pipelineLayout = m_device->pipelineLayoutBuilder().addSetLayout(m_descriptorSetLayout.get()).create();
+
+    m_pipeline = m_device->pipelineBuilder()
+                         .addShaderStage(VK_SHADER_STAGE_VERTEX_BIT, m_vertexShaderModule.get(), V::SpecializationConstants().set(0, ParticleSize))
+                         .addShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, m_fragmentShaderModule.get())
+                         .create(m_pipelineLayout.get(), m_swapchain->renderPass());
+
+    m_computeCommandPools = std::make_unique<V::ThreadCommandPools>(m_device.get(), 1, backbufferCount, m_device->computeQueueFamilyIndex());
+    m_commandPools = std::make_unique<V::ThreadCommandPools>(m_device.get(), 1, backbufferCount);
+
+    m_frameFences.reserve(backbufferCount);
+    for (size_t i = 0; i < backbufferCount; ++i)
+        m_frameFences.push_back(m_device->createFence(true));
+}
+
+VulkanRenderer::~VulkanRenderer()
+{
+    for (auto &fence : m_frameFences)
+        fence->wait();
+}
+
+void VulkanRenderer::render()
+{
+    // a resize recreates the swapchain and its framebuffers, the pipelines do not depend on the size
+    int width, height;
+    glfwGetFramebufferSize(m_window, &width, &height);
+    if (width == 0 || height == 0)
+        return; // minimized
+    if (m_swapchain->needsResize(width, height)) {
+        m_device->waitIdle();
+        m_swapchain->resize(width, height);
+    }
+
+    uint32_t imageIndex = m_swapchain->acquireNextImage(m_imageAvailableSemaphore.get());
+
+    // also covers the compute work of the frame, which the graphics submission waited for
+    m_frameFences[imageIndex]->wait();
+    m_frameFences[imageIndex]->reset();
+
+    const V::Buffer *particleBuffer = m_particleBuffers[imageIndex].get();
+    const V::DescriptorSet *descriptorSet = m_descriptorSets[imageIndex].get();
+    const bool transferOwnership = m_device->hasDedicatedComputeQueue();
+
+    VkBufferMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = particleBuffer->handle(),
+        .offset = 0,
+        .size = VK_WHOLE_SIZE
+    };
+
+    // compute: animate the particles, previous contents are discarded so there is no acquire
+    m_computeCommandPools->beginFrame(imageIndex);
+    auto *computeCommandBuffer = m_computeCommandPools->commandBuffer(0);
+    computeCommandBuffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    computeCommandBuffer->bindPipeline(m_computePipeline.get());
+    computeCommandBuffer->bindDescriptorSet(m_computePipelineLayout.get(), descriptorSet);
+    computeCommandBuffer->pushConstants(m_computePipelineLayout.get(), VK_SHADER_STAGE_COMPUTE_BIT, ComputePushConstants { static_cast<float>(glfwGetTime()), ParticleCount });
+    computeCommandBuffer->dispatch((ParticleCount + WorkgroupSize - 1) / WorkgroupSize);
+    if (transferOwnership) {
+        VkBufferMemoryBarrier releaseBarrier = barrier;
+        releaseBarrier.dstAccessMask = 0;
+        releaseBarrier.srcQueueFamilyIndex = m_device->computeQueueFamilyIndex();
+        releaseBarrier.dstQueueFamilyIndex = m_device->queueFamilyIndex();
+        computeCommandBuffer->bufferMemoryBarriers(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, { releaseBarrier });
+    } else {
+        computeCommandBuffer->bufferMemoryBarriers(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, { barrier });
+    }
+    computeCommandBuffer->end();
+
+    const VkCommandBuffer computeCommandBufferHandle = computeCommandBuffer->handle();
+    const VkSemaphore computeFinished = m_computeFinishedSemaphore->handle();
+    VkSubmitInfo computeSubmitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &computeCommandBufferHandle,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &computeFinished
+    };
+    if (vkQueueSubmit(m_device->computeQueue(), 1, &computeSubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+        throw std::runtime_error("Failed to submit compute command");
+
+    // graphics: take over the particles and draw a triangle for each
+    m_commandPools->beginFrame(imageIndex);
+    auto *commandBuffer = m_commandPools->commandBuffer(0);
+    commandBuffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    if (transferOwnership) {
+        VkBufferMemoryBarrier acquireBarrier = barrier;
+        acquireBarrier.srcAccessMask = 0;
+        acquireBarrier.srcQueueFamilyIndex = m_device->computeQueueFamilyIndex();
+        acquireBarrier.dstQueueFamilyIndex = m_device->queueFamilyIndex();
+        commandBuffer->bufferMemoryBarriers(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, { acquireBarrier });
+    }
+
+    const VkRect2D renderArea = {
+        .offset = VkOffset2D { 0, 0 },
+        .extent = VkExtent2D { m_swapchain->width(), m_swapchain->height() }
+    };
+    commandBuffer->beginRenderPass(m_swapchain->renderPass(), m_swapchain->framebuffers()[imageIndex], renderArea);
+    commandBuffer->setViewportAndScissor(renderArea);
+    commandBuffer->bindPipeline(m_pipeline.get());
+    commandBuffer->bindDescriptorSet(m_pipelineLayout.get(), descriptorSet);
+    commandBuffer->draw(3, ParticleCount, 0, 0);
+    commandBuffer->endRenderPass();
+    commandBuffer->end();
+
+    const VkCommandBuffer commandBufferHandle = commandBuffer->handle();
+    const VkSemaphore waitSemaphores[] = { m_imageAvailableSemaphore->handle(), computeFinished };
+    const VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT };
+    const VkSemaphore renderFinished = m_renderFinishedSemaphore->handle();
+
+    VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .waitSemaphoreCount = 2,
+        .pWaitSemaphores = waitSemaphores,
+        .pWaitDstStageMask = waitStages,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &commandBufferHandle,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &renderFinished
+    };
+    if (vkQueueSubmit(m_device->queue(), 1, &submitInfo, m_frameFences[imageIndex]->handle()) != VK_SUCCESS)
+        throw std::runtime_error("Failed to submit command");
+
+    m_swapchain->queuePresent(imageIndex, m_renderFinishedSemaphore.get());
+}
+
+void VulkanRenderer::dumpStatistics()
+{
+    std::cout << (m_device->hasDedicatedComputeQueue() ? "Using the async compute queue family " : "Using the graphics queue family ") << m_device->computeQueueFamilyIndex() << " for compute\n";
+    std::cout << m_device->memoryStatistics().toJson() << '\n';
+}
+
+class Demo
+{
+public:
+    Demo();
+    ~Demo();
+
+    void initialize(int width, int height, const char *title);
+    void terminate();
+
+    void renderLoop();
+
+private:
+    static void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods);
+    void keyEvent(int key, int scancode, int action, int mods);
+
+    GLFWwindow *m_window = nullptr;
+    std::unique_ptr<VulkanRenderer> m_renderer;
+};
+
+Demo::Demo()
+{
+    glfwInit();
+    glfwSetErrorCallback([](int error, const char *description) {
+        std::cerr << "GLFW error " << error << ": " << description << '\n';
+    });
+}
+
+Demo::~Demo()
+{
+    terminate();
+}
+
+void Demo::initialize(int width, int height, const char *title)
+{
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    m_window = glfwCreateWindow(width, height, title, nullptr, nullptr);
+    glfwSetWindowUserPointer(m_window, this);
+    glfwSetKeyCallback(m_window, Demo::keyCallback);
+
+    m_renderer.reset(new VulkanRenderer(m_window, width, height));
+}
+
+void Demo::terminate()
+{
+    m_renderer.reset();
+
+    glfwDestroyWindow(m_window);
+    glfwTerminate();
+}
+
+void Demo::renderLoop()
+{
+    constexpr double StatisticsInterval = 10.0; // seconds
+
+    double lastStatisticsTime = glfwGetTime();
+    while (!glfwWindowShouldClose(m_window)) {
+        m_renderer->render();
+        glfwPollEvents();
+
+        const double time = glfwGetTime();
+        if (time - lastStatisticsTime >= StatisticsInterval) {
+            m_renderer->dumpStatistics();
+            lastStatisticsTime = time;
+        }
+    }
+}
+
+void Demo::keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+    auto *demo = reinterpret_cast<Demo *>(glfwGetWindowUserPointer(window));
+    demo->keyEvent(key, scancode, action, mods);
+}
+
+void Demo::keyEvent(int key, int scancode, int action, int mods)
+{
+    if (action == GLFW_PRESS && key == GLFW_KEY_ESCAPE)
+        glfwSetWindowShouldClose(m_window, 1);
+}
+
+int main()
+{
+    Demo demo;
+    demo.initialize(1200, 600, "compute");
+    demo.renderLoop();
+}
@@ -0,0 +1,166 @@
+#include "vbuffer.h"
+#include "vcommandbuffer.h"
+#include "vcommandpool.h"
+#include "vdevice.h"
+#include "vfence.h"
+#include "vpipeline.h"
+#include "vpipelinelayout.h"
+#include "vsemaphore.h"
+#include "vshadermodule.h"
+#include "vsurface.h"
+#include "vswapchain.h"
+#include "vuploader.h"
+
+#include "shaders/test_frag.h"
+#include "shaders/test_vertexbuffer_vert.h"
+
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+// Benchmark for indirect drawing: 100k small triangles drawn with one drawIndexed() per object,
+// then with a single drawIndexedIndirect() reading the same draws from a buffer. Reports the
+// time to record the command buffer and the time until the GPU has finished the frame.
+
+namespace {
+
+struct Vertex {
+    float x, y, z, w;
+    float r, g, b, a;
+};
+
+} // namespace
+
+int main()
+{
+    constexpr uint32_t ObjectCount = 100000;
+    constexpr uint32_t GridSize = 400; // objects per row
+    constexpr int FramesPerRun = 10;
+    constexpr int Width = 512;
+    constexpr int Height = 512;
+
+    glfwInit();
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    glfwWindowHint(GLFW_VISIBLE, 0);
+    GLFWwindow *window = glfwCreateWindow(Width, Height, "indirect", nullptr, nullptr);
+
+    {
+        V::Device device;
+        auto surface = device.createSurface(window);
+        auto swapchain = surface->createSwapchain(Width, Height, 3);
+        auto vertexShaderModule = device.createShaderModule(test_vertexbuffer_vert);
+        auto fragmentShaderModule = device.createShaderModule(test_frag);
+        // test_vertexbuffer.vert offsets the positions by a push constant, which stays zero here
+        const float positionOffset[4] = {};
+        auto pipelineLayout = device.pipelineLayoutBuilder().addPushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, 0, 4 * sizeof(float)).create();
+        auto pipeline = device.pipelineBuilder()
+                                .addVertexInputBinding(0, sizeof(Vertex))
+                                .addVertexInputAttribute(0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 0)
+                                .addVertexInputAttribute(1, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 4 * sizeof(float))
+                                .addShaderStage(VK_SHADER_STAGE_VERTEX_BIT, vertexShaderModule.get())
+                                .addShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShaderModule.get())
+                                .create(pipelineLayout.get(), swapchain->renderPass());
+
+        // one small triangle per object on a grid, all sharing the same three indices
+        std::vector<Vertex> vertices;
+        vertices.reserve(3 * ObjectCount);
+        std::vector<VkDrawIndexedIndirectCommand> drawCommands;
+        drawCommands.reserve(ObjectCount);
+        const float cellSize = 2.0f / GridSize;
+        for (uint32_t i = 0; i < ObjectCount; ++i) {
+            const float x = -1.0f + (i % GridSize) * cellSize;
+            const float y = -1.0f + (i / GridSize) * cellSize;
+            vertices.push_back({ x + .5f * cellSize, y, 0, 1, 1, 0, 0, 1 });
+            vertices.push_back({ x + cellSize, y + cellSize, 0, 1, 1, 1, 0, 1 });
+            vertices.push_back({ x, y + cellSize, 0, 1, 1, 1, 1, 1 });
+            drawCommands.push_back({ .indexCount = 3, .instanceCount = 1, .firstIndex = 0, .vertexOffset = static_cast<int32_t>(3 * i), .firstInstance = 0 });
+        }
+        static const uint16_t indices[] = { 0, 1, 2 };
+
+        auto vertexBuffer = device.createBuffer(vertices.size() * sizeof(Vertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, V::MemoryUsage::GpuOnly);
+        auto indexBuffer = device.createBuffer(sizeof(indices), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, V::MemoryUsage::GpuOnly);
+        auto indirectBuffer = device.createBuffer(drawCommands.size() * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, V::MemoryUsage::GpuOnly);
+        {
+            V::Uploader uploader(&device);
+            uploader.upload(vertexBuffer.get(), 0, vertices.data(), vertices.size() * sizeof(Vertex));
+            uploader.upload(indexBuffer.get(), 0, indices, sizeof(indices));
+            uploader.upload(indirectBuffer.get(), 0, drawCommands.data(), drawCommands.size() * sizeof(VkDrawIndexedIndirectCommand));
+            uploader.wait(uploader.submit());
+        }
+
+        auto commandPool = device.createCommandPool(device.queueFamilyIndex(), VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+        auto commandBuffer = commandPool->allocateCommandBuffer();
+        auto imageAvailableSemaphore = device.createSemaphore();
+        auto renderFinishedSemaphore = device.createSemaphore();
+        auto fence = device.createFence();
+
+        const auto run = [&](const char *name, const std::function<void()> &recordDraws) {
+            std::chrono::duration<double, std::milli> recordTime(0);
+            std::chrono::duration<double, std::milli> frameTime(0);
+            for (int frame = 0; frame < FramesPerRun; ++frame) {
+                // acquiring recreates the swapchain if it went out of date, possibly with a new extent
+                const uint32_t imageIndex = swapchain->acquireNextImage(imageAvailableSemaphore.get());
+                const VkRect2D renderArea = {
+                    .offset = VkOffset2D { 0, 0 },
+                    .extent = VkExtent2D { swapchain->width(), swapchain->height() }
+                };
+                commandPool->reset();
+
+                const auto start = std::chrono::steady_clock::now();
+                commandBuffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+                commandBuffer->beginRenderPass(swapchain->renderPass(), swapchain->framebuffers()[imageIndex], renderArea);
+                commandBuffer->setViewportAndScissor(renderArea);
+                commandBuffer->bindPipeline(pipeline.get());
+                commandBuffer->pushConstants(pipelineLayout.get(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(positionOffset), positionOffset);
+                commandBuffer->bindVertexBuffers({ vertexBuffer.get() });
+                commandBuffer->bindIndexBuffer(indexBuffer.get(), VK_INDEX_TYPE_UINT16);
+                recordDraws();
+                commandBuffer->endRenderPass();
+                commandBuffer->end();
+                const auto recorded = std::chrono::steady_clock::now();
+
+                const VkCommandBuffer commandBufferHandle = commandBuffer->handle();
+                const VkSemaphore imageAvailable = imageAvailableSemaphore->handle();
+                const VkSemaphore renderFinished = renderFinishedSemaphore->handle();
+                const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+                VkSubmitInfo submitInfo = {
+                    .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                    .waitSemaphoreCount = 1,
+                    .pWaitSemaphores = &imageAvailable,
+                    .pWaitDstStageMask = &waitStage,
+                    .commandBufferCount = 1,
+                    .pCommandBuffers = &commandBufferHandle,
+                    .signalSemaphoreCount = 1,
+                    .pSignalSemaphores = &renderFinished
+                };
+                if (vkQueueSubmit(device.queue(), 1, &submitInfo, fence->handle()) != VK_SUCCESS)
+                    throw std::runtime_error("Failed to submit command");
+                fence->wait();
+                fence->reset();
+                const auto finished = std::chrono::steady_clock::now();
+
+                swapchain->queuePresent(imageIndex, renderFinishedSemaphore.get());
+
+                recordTime += recorded - start;
+                frameTime += finished - start;
+            }
+            std::cout << name << ": recorded in " << recordTime.count() / FramesPerRun << " ms, frame done after " << frameTime.count() / FramesPerRun << " ms\n";
+        };
+
+        run("drawIndexed per object", [&] {
+            for (uint32_t i = 0; i < ObjectCount; ++i)
+                commandBuffer->drawIndexed(3, 1, 0, 3 * i, 0);
+        });
+        run(device.enabledFeatures().multiDrawIndirect ? "multi-draw drawIndexedIndirect" : "drawIndexedIndirect (one call per draw, no multiDrawIndirect)", [&] {
+            commandBuffer->drawIndexedIndirect(indirectBuffer.get(), ObjectCount);
+        });
+    }
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+}
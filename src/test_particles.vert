@@ -0,0 +1,22 @@
+#version 450
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+layout(location=0) out vec4 fragColor;
+
+layout(binding=0) readonly buffer PositionBuffer
+{
+    vec4 positions[];
+} positionBuffer;
+
+layout(constant_id=0) const float particleSize = 0.004;
+
+const vec2 corners[3] = vec2[](vec2(0.0, -particleSize), vec2(particleSize, particleSize), vec2(-particleSize, particleSize));
+
+void main()
+{
+    gl_Position = positionBuffer.positions[gl_InstanceIndex] + vec4(corners[gl_VertexIndex], 0.0, 0.0);
+    fragColor = vec4(1.0, 0.8, 0.3, 1.0);
+}
@@ -0,0 +1,135 @@
+#include "vdescriptorsetlayout.h"
+#include "vdevice.h"
+#include "vhostallocator.h"
+#include "vpipeline.h"
+#include "vpipelinecache.h"
+#include "vpipelinelayout.h"
+#include "vshadermodule.h"
+
+#include "shaders/test_compute_comp.h"
+#include "shaders/test_frag.h"
+#include "shaders/test_particles_vert.h"
+#include "shaders/test_sprites_vert.h"
+#include "shaders/test_ssbo_vert.h"
+#include "shaders/test_vertexbuffer_vert.h"
+
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+// Measures how long creating the pipelines of the test programs takes with an empty pipeline
+// cache, and again on a second run that loads the cache saved by the first one. Drivers may
+// keep a cache of their own, which also makes the cold run faster when repeated.
+
+namespace {
+
+constexpr const char *PipelineCachePath = "test_pipelinecache.bin";
+
+VkRenderPass createRenderPass(const V::Device *device)
+{
+    VkAttachmentDescription attachmentDescription = {
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+    };
+
+    VkAttachmentReference attachmentReference = {
+        .attachment = 0,
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+    };
+
+    VkSubpassDescription subpassDescription = {
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &attachmentReference,
+    };
+
+    VkRenderPassCreateInfo renderPassCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = 1,
+        .pAttachments = &attachmentDescription,
+        .subpassCount = 1,
+        .pSubpasses = &subpassDescription,
+    };
+
+    VkRenderPass renderPass;
+    if (vkCreateRenderPass(device->device(), &renderPassCreateInfo, device->allocationCallbacks(), &renderPass) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create render pass");
+    return renderPass;
+}
+
+// the pipelines of test_vertexbuffer, test_ssbo, test_sprites and test_compute
+void createPipelines(const V::Device *device, VkRenderPass renderPass)
+{
+    auto fragmentShaderModule = device->createShaderModule(test_frag);
+    auto vertexBufferShaderModule = device->createShaderModule(test_vertexbuffer_vert);
+    auto ssboShaderModule = device->createShaderModule(test_ssbo_vert);
+    auto spritesShaderModule = device->createShaderModule(test_sprites_vert);
+    auto particlesShaderModule = device->createShaderModule(test_particles_vert);
+    auto computeShaderModule = device->createShaderModule(test_compute_comp);
+
+    auto storageSetLayout = device->descriptorSetLayoutBuilder()
+                                    .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+                                    .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+                                    .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+                                    .create();
+    auto vertexBufferLayout = device->pipelineLayoutBuilder().addPushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, 0, 4 * sizeof(float)).create();
+    auto storageLayout = device->pipelineLayoutBuilder().addSetLayout(storageSetLayout.get()).create();
+    auto computeLayout = device->pipelineLayoutBuilder().addSetLayout(storageSetLayout.get()).addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, 0, 2 * sizeof(uint32_t)).create();
+
+    std::vector<std::unique_ptr<V::Pipeline>> pipelines;
+    pipelines.push_back(device->pipelineBuilder()
+                                .addVertexInputBinding(0, 8 * sizeof(float))
+                                .addVertexInputAttribute(0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 0)
+                                .addVertexInputAttribute(1, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 4 * sizeof(float))
+                                .addShaderStage(VK_SHADER_STAGE_VERTEX_BIT, vertexBufferShaderModule.get())
+                                .addShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShaderModule.get())
+                                .create(vertexBufferLayout.get(), renderPass));
+    for (auto *shaderModule : { ssboShaderModule.get(), spritesShaderModule.get(), particlesShaderModule.get() }) {
+        pipelines.push_back(device->pipelineBuilder()
+                                    .addShaderStage(VK_SHADER_STAGE_VERTEX_BIT, shaderModule)
+                                    .addShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShaderModule.get())
+                                    .create(storageLayout.get(), renderPass));
+    }
+    pipelines.push_back(device->computePipelineBuilder()
+                                .setShader(computeShaderModule.get())
+                                .create(computeLayout.get()));
+}
+
+void measure(const char *name)
+{
+    V::Device device(std::make_unique<V::HostAllocator>(), PipelineCachePath);
+    const VkRenderPass renderPass = createRenderPass(&device);
+
+    const auto start = std::chrono::steady_clock::now();
+    createPipelines(&device, renderPass);
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+    std::cout << name << ": created pipelines in " << elapsed.count() / 1000.0 << " ms, " << device.pipelineCache()->loadedSize() << " bytes loaded from " << PipelineCachePath << ", " << device.pipelineCache()->data().size() << " bytes in the cache\n";
+
+    vkDestroyRenderPass(device.device(), renderPass, device.allocationCallbacks());
+}
+
+} // namespace
+
+int main()
+{
+    glfwInit();
+
+    // the device saves the cache when it is destroyed, so the second run starts warm
+    std::remove(PipelineCachePath);
+    measure("Cold");
+    measure("Warm");
+
+    glfwTerminate();
+}
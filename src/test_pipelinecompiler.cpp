@@ -0,0 +1,145 @@
+#include "vcommandbuffer.h"
+#include "vdescriptorsetlayout.h"
+#include "vdevice.h"
+#include "vfence.h"
+#include "vhostallocator.h"
+#include "vpipeline.h"
+#include "vpipelinecompiler.h"
+#include "vpipelinelayout.h"
+#include "vsemaphore.h"
+#include "vshadermodule.h"
+#include "vsurface.h"
+#include "vswapchain.h"
+#include "vthreadcommandpools.h"
+
+#include "shaders/test_frag.h"
+#include "shaders/test_particles_vert.h"
+#include "shaders/test_sprites_vert.h"
+#include "shaders/test_ssbo_vert.h"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// A loading screen: hundreds of pipeline variants are compiled on the worker threads of a
+// PipelineCompiler while the main thread keeps presenting frames, then the compile times of
+// the individual pipelines are reported.
+
+int main()
+{
+    constexpr uint32_t PipelineCount = 300;
+    constexpr uint32_t FrameCount = 3;
+    constexpr int Width = 800;
+    constexpr int Height = 600;
+
+    glfwInit();
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    GLFWwindow *window = glfwCreateWindow(Width, Height, "loading", nullptr, nullptr);
+
+    {
+        // without a pipeline cache, so that every run compiles
+        V::Device device(std::make_unique<V::HostAllocator>(), nullptr);
+        auto surface = device.createSurface(window);
+        auto swapchain = surface->createSwapchain(Width, Height, FrameCount);
+        auto fragmentShaderModule = device.createShaderModule(test_frag);
+        std::vector<std::unique_ptr<V::ShaderModule>> vertexShaderModules;
+        vertexShaderModules.push_back(device.createShaderModule(test_ssbo_vert));
+        vertexShaderModules.push_back(device.createShaderModule(test_sprites_vert));
+        vertexShaderModules.push_back(device.createShaderModule(test_particles_vert));
+        auto setLayout = device.descriptorSetLayoutBuilder()
+                                 .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+                                 .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+                                 .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+                                 .create();
+        auto pipelineLayout = device.pipelineLayoutBuilder().addSetLayout(setLayout.get()).create();
+
+        V::PipelineCompiler compiler(&device);
+
+        const auto start = std::chrono::steady_clock::now();
+
+        // the variants differ in their shaders and viewport, enough for the driver to compile each
+        std::vector<std::future<std::unique_ptr<V::Pipeline>>> futures;
+        for (uint32_t i = 0; i < PipelineCount; ++i) {
+            auto builder = device.pipelineBuilder()
+                                   .setViewport(Width - i, Height)
+                                   .addShaderStage(VK_SHADER_STAGE_VERTEX_BIT, vertexShaderModules[i % vertexShaderModules.size()].get())
+                                   .addShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShaderModule.get());
+            futures.push_back(compiler.compile(builder, pipelineLayout.get(), swapchain->renderPass()));
+        }
+
+        V::ThreadCommandPools commandPools(&device, 1, FrameCount);
+        auto imageAvailableSemaphore = device.createSemaphore();
+        auto renderFinishedSemaphore = device.createSemaphore();
+        std::vector<std::unique_ptr<V::Fence>> frameFences;
+        for (uint32_t i = 0; i < FrameCount; ++i)
+            frameFences.push_back(device.createFence(true));
+
+        int presentedFrames = 0;
+        while (compiler.pendingCount() > 0 && !glfwWindowShouldClose(window)) {
+            // acquiring recreates the swapchain if it went out of date, possibly with a new extent
+            const uint32_t imageIndex = swapchain->acquireNextImage(imageAvailableSemaphore.get());
+            const VkRect2D renderArea = {
+                .offset = VkOffset2D { 0, 0 },
+                .extent = VkExtent2D { swapchain->width(), swapchain->height() }
+            };
+            frameFences[imageIndex]->wait();
+            frameFences[imageIndex]->reset();
+
+            commandPools.beginFrame(imageIndex);
+            auto *commandBuffer = commandPools.commandBuffer(0);
+            commandBuffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+            commandBuffer->beginRenderPass(swapchain->renderPass(), swapchain->framebuffers()[imageIndex], renderArea);
+            commandBuffer->endRenderPass();
+            commandBuffer->end();
+
+            const VkCommandBuffer commandBufferHandle = commandBuffer->handle();
+            const VkSemaphore imageAvailable = imageAvailableSemaphore->handle();
+            const VkSemaphore renderFinished = renderFinishedSemaphore->handle();
+            const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            VkSubmitInfo submitInfo = {
+                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                .waitSemaphoreCount = 1,
+                .pWaitSemaphores = &imageAvailable,
+                .pWaitDstStageMask = &waitStage,
+                .commandBufferCount = 1,
+                .pCommandBuffers = &commandBufferHandle,
+                .signalSemaphoreCount = 1,
+                .pSignalSemaphores = &renderFinished
+            };
+            if (vkQueueSubmit(device.queue(), 1, &submitInfo, frameFences[imageIndex]->handle()) != VK_SUCCESS)
+                throw std::runtime_error("Failed to submit command");
+            swapchain->queuePresent(imageIndex, renderFinishedSemaphore.get());
+
+            ++presentedFrames;
+            glfwPollEvents();
+        }
+
+        std::vector<std::unique_ptr<V::Pipeline>> pipelines;
+        for (auto &future : futures)
+            pipelines.push_back(future.get());
+
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::vector<double> compileTimes;
+        for (const auto &pipeline : pipelines)
+            compileTimes.push_back(pipeline->compileTime().count() / 1000.0);
+        std::sort(compileTimes.begin(), compileTimes.end());
+        double totalCompileTime = 0;
+        for (double compileTime : compileTimes)
+            totalCompileTime += compileTime;
+
+        std::cout << "Compiled " << PipelineCount << " pipelines on " << compiler.threadCount() << " threads in " << elapsed.count() << " ms, presenting " << presentedFrames << " frames meanwhile\n";
+        std::cout << "Per pipeline: min " << compileTimes.front() << " ms, median " << compileTimes[compileTimes.size() / 2] << " ms, max " << compileTimes.back() << " ms, sum " << totalCompileTime << " ms\n";
+
+        for (auto &fence : frameFences)
+            fence->wait();
+    }
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+}
@@ -0,0 +1,147 @@
+#include "vdescriptorsetlayout.h"
+#include "vdevice.h"
+#include "vhostallocator.h"
+#include "vpipeline.h"
+#include "vpipelinelayout.h"
+#include "vpipelineregistry.h"
+#include "vrenderpasskey.h"
+#include "vshadermodule.h"
+
+#include "shaders/test_frag.h"
+#include "shaders/test_particles_vert.h"
+#include "shaders/test_sprites_vert.h"
+#include "shaders/test_ssbo_vert.h"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Several render threads ask a PipelineRegistry for the same few dozen pipeline variants every
+// frame, the way materials would. Only the first request of each variant compiles.
+
+namespace {
+
+VkRenderPass createRenderPass(const V::Device *device, VkAttachmentLoadOp loadOp, V::RenderPassKey *renderPassKey)
+{
+    VkAttachmentDescription attachmentDescription = {
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .loadOp = loadOp,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+    };
+
+    VkAttachmentReference attachmentReference = {
+        .attachment = 0,
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+    };
+
+    VkSubpassDescription subpassDescription = {
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &attachmentReference,
+    };
+
+    VkRenderPassCreateInfo renderPassCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = 1,
+        .pAttachments = &attachmentDescription,
+        .subpassCount = 1,
+        .pSubpasses = &subpassDescription,
+    };
+
+    VkRenderPass renderPass;
+    if (vkCreateRenderPass(device->device(), &renderPassCreateInfo, device->allocationCallbacks(), &renderPass) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create render pass");
+    *renderPassKey = V::RenderPassKey(renderPassCreateInfo);
+    return renderPass;
+}
+
+} // namespace
+
+int main()
+{
+    constexpr uint32_t VariantCount = 48;
+    constexpr int FrameCount = 200;
+    constexpr uint32_t Width = 800;
+    constexpr uint32_t Height = 600;
+
+    glfwInit();
+
+    {
+        // without a pipeline cache, so that misses really compile
+        V::Device device(std::make_unique<V::HostAllocator>(), nullptr);
+        V::RenderPassKey renderPassKey;
+        const VkRenderPass renderPass = createRenderPass(&device, VK_ATTACHMENT_LOAD_OP_CLEAR, &renderPassKey);
+        auto fragmentShaderModule = device.createShaderModule(test_frag);
+        std::vector<std::unique_ptr<V::ShaderModule>> vertexShaderModules;
+        vertexShaderModules.push_back(device.createShaderModule(test_ssbo_vert));
+        vertexShaderModules.push_back(device.createShaderModule(test_sprites_vert));
+        vertexShaderModules.push_back(device.createShaderModule(test_particles_vert));
+        auto setLayout = device.descriptorSetLayoutBuilder()
+                                 .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+                                 .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+                                 .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+                                 .create();
+        auto pipelineLayout = device.pipelineLayoutBuilder().addSetLayout(setLayout.get()).create();
+
+        // the builders are set up anew for every request, as a renderer deriving them from materials would
+        const auto variantBuilder = [&](uint32_t variant) {
+            return device.pipelineBuilder()
+                    .setViewport(Width - variant / vertexShaderModules.size(), Height)
+                    .addShaderStage(VK_SHADER_STAGE_VERTEX_BIT, vertexShaderModules[variant % vertexShaderModules.size()].get())
+                    .addShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShaderModule.get());
+        };
+
+        V::PipelineRegistry registry(&device);
+        const uint32_t threadCount = std::max(2u, std::thread::hardware_concurrency());
+
+        const auto start = std::chrono::steady_clock::now();
+
+        std::vector<std::thread> threads;
+        for (uint32_t threadIndex = 0; threadIndex < threadCount; ++threadIndex) {
+            threads.emplace_back([&, threadIndex] {
+                for (int frame = 0; frame < FrameCount; ++frame) {
+                    for (uint32_t i = 0; i < VariantCount; ++i) {
+                        const uint32_t variant = (i + threadIndex) % VariantCount;
+                        if (!registry.pipeline(variantBuilder(variant), pipelineLayout.get(), renderPass, renderPassKey))
+                            throw std::runtime_error("No pipeline");
+                    }
+                }
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        const auto statistics = registry.statistics();
+        const double compileTime = statistics.compileTime.count() / 1000.0;
+        const double averageCompileTime = statistics.misses ? compileTime / statistics.misses : 0.0;
+
+        std::cout << threadCount << " threads requested " << statistics.hits + statistics.misses << " pipelines in " << elapsed.count() << " ms: " << statistics.hits << " hits, " << statistics.misses << " misses, " << registry.pipelineCount() << " distinct pipelines\n";
+        std::cout << "Compiled for " << compileTime << " ms, avoided about " << statistics.hits * averageCompileTime << " ms of compiling\n";
+
+        // load ops don't affect compatibility, so a render pass that only differs in them shares the pipelines
+        V::RenderPassKey compatibleRenderPassKey;
+        const VkRenderPass compatibleRenderPass = createRenderPass(&device, VK_ATTACHMENT_LOAD_OP_LOAD, &compatibleRenderPassKey);
+        const size_t pipelineCount = registry.pipelineCount();
+        for (uint32_t variant = 0; variant < VariantCount; ++variant)
+            registry.pipeline(variantBuilder(variant), pipelineLayout.get(), compatibleRenderPass, compatibleRenderPassKey);
+        if (registry.pipelineCount() != pipelineCount)
+            throw std::runtime_error("Compatible render pass didn't share pipelines");
+
+        vkDestroyRenderPass(device.device(), compatibleRenderPass, device.allocationCallbacks());
+        vkDestroyRenderPass(device.device(), renderPass, device.allocationCallbacks());
+    }
+
+    glfwTerminate();
+}
@@ -0,0 +1,191 @@
+#include "vbuffer.h"
+#include "vcommandbuffer.h"
+#include "vdevice.h"
+#include "vpipeline.h"
+#include "vpipelinelayout.h"
+#include "vshadermodule.h"
+#include "vsurface.h"
+#include "vswapchain.h"
+#include "vthreadcommandpools.h"
+
+#include "shaders/test_frag.h"
+#include "shaders/test_vertexbuffer_vert.h"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Benchmark for parallel command recording: the same scene of many small draws is recorded
+// into secondary command buffers by an increasing number of worker threads, each with its own
+// command pools, and the primary command buffer executes them inside the render pass.
+
+namespace {
+
+// Threads that are started once and run the job on every thread for each call to run(), so that
+// the frame times don't include creating threads.
+class Workers
+{
+public:
+    Workers(uint32_t threadCount, std::function<void(uint32_t)> job)
+        : m_job(std::move(job))
+    {
+        for (uint32_t threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+            m_threads.emplace_back(&Workers::work, this, threadIndex);
+    }
+
+    ~Workers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_start.notify_all();
+        for (auto &thread : m_threads)
+            thread.join();
+    }
+
+    // returns once every thread has run the job
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        ++m_generation;
+        m_pendingCount = m_threads.size();
+        m_start.notify_all();
+        m_done.wait(lock, [this] { return m_pendingCount == 0; });
+    }
+
+private:
+    void work(uint32_t threadIndex)
+    {
+        uint64_t generation = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_start.wait(lock, [&] { return m_stop || m_generation != generation; });
+                if (m_stop)
+                    return;
+                generation = m_generation;
+            }
+
+            m_job(threadIndex);
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_pendingCount == 0)
+                m_done.notify_one();
+        }
+    }
+
+    std::function<void(uint32_t)> m_job;
+    std::mutex m_mutex;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    uint64_t m_generation = 0;
+    size_t m_pendingCount = 0;
+    bool m_stop = false;
+    std::vector<std::thread> m_threads;
+};
+
+} // namespace
+
+int main()
+{
+    constexpr uint32_t DrawCount = 100000;
+    constexpr uint32_t FrameCount = 3;
+    constexpr int FramesPerRun = 20;
+    constexpr int Width = 256;
+    constexpr int Height = 256;
+
+    glfwInit();
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    glfwWindowHint(GLFW_VISIBLE, 0);
+    GLFWwindow *window = glfwCreateWindow(Width, Height, "recording", nullptr, nullptr);
+
+    {
+        V::Device device;
+        auto surface = device.createSurface(window);
+        auto swapchain = surface->createSwapchain(Width, Height, FrameCount);
+        auto vertexShaderModule = device.createShaderModule(test_vertexbuffer_vert);
+        auto fragmentShaderModule = device.createShaderModule(test_frag);
+        // test_vertexbuffer.vert offsets the positions by a push constant, which stays zero here
+        const float positionOffset[4] = {};
+        auto pipelineLayout = device.pipelineLayoutBuilder().addPushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, 0, 4 * sizeof(float)).create();
+        auto pipeline = device.pipelineBuilder()
+                                .addVertexInputBinding(0, 8 * sizeof(float))
+                                .addVertexInputAttribute(0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 0)
+                                .addVertexInputAttribute(1, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 4 * sizeof(float))
+                                .addShaderStage(VK_SHADER_STAGE_VERTEX_BIT, vertexShaderModule.get())
+                                .addShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShaderModule.get())
+                                .create(pipelineLayout.get(), swapchain->renderPass());
+        auto vertexBuffer = device.createBuffer(3 * 8 * sizeof(float), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, V::MemoryUsage::GpuOnly);
+
+        const VkRenderPass renderPass = swapchain->renderPass();
+        const VkRect2D renderArea = {
+            .offset = VkOffset2D { 0, 0 },
+            .extent = VkExtent2D { swapchain->width(), swapchain->height() }
+        };
+
+        const uint32_t maxThreadCount = std::max(1u, std::thread::hardware_concurrency());
+
+        double singleThreadTime = 0;
+        for (uint32_t threadCount = 1; threadCount <= maxThreadCount; threadCount *= 2) {
+            V::ThreadCommandPools commandPools(&device, threadCount, FrameCount);
+            V::CommandBuffer::BindStatistics bindStatistics;
+
+            // set for each frame before the workers are run
+            VkFramebuffer framebuffer = VK_NULL_HANDLE;
+            std::vector<const V::CommandBuffer *> secondaryCommandBuffers(threadCount);
+            Workers workers(threadCount, [&](uint32_t threadIndex) {
+                auto *commandBuffer = commandPools.commandBuffer(threadIndex, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+                commandBuffer->begin(renderPass, 0, framebuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+                commandBuffer->setViewportAndScissor(renderArea);
+                commandBuffer->bindPipeline(pipeline.get());
+                commandBuffer->pushConstants(pipelineLayout.get(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(positionOffset), positionOffset);
+                for (uint32_t i = threadIndex; i < DrawCount; i += threadCount) {
+                    commandBuffer->bindVertexBuffers({ vertexBuffer.get() });
+                    commandBuffer->draw(3, 1, 0, i);
+                }
+                commandBuffer->end();
+                secondaryCommandBuffers[threadIndex] = commandBuffer;
+            });
+
+            const auto start = std::chrono::steady_clock::now();
+
+            // the command buffers are only recorded, never submitted, so the pools can be reset right away
+            for (int frame = 0; frame < FramesPerRun; ++frame) {
+                const uint32_t frameIndex = frame % FrameCount;
+                framebuffer = swapchain->framebuffers()[frameIndex];
+                commandPools.beginFrame(frameIndex);
+
+                workers.run();
+
+                bindStatistics = {};
+                for (const auto *secondaryCommandBuffer : secondaryCommandBuffers)
+                    bindStatistics.add(secondaryCommandBuffer->bindStatistics());
+
+                auto *commandBuffer = commandPools.commandBuffer(0);
+                commandBuffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+                commandBuffer->beginRenderPass(renderPass, framebuffer, renderArea, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+                commandBuffer->executeCommands(secondaryCommandBuffers);
+                commandBuffer->endRenderPass();
+                commandBuffer->end();
+            }
+
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            const double frameTime = elapsed.count() / FramesPerRun;
+            if (threadCount == 1)
+                singleThreadTime = frameTime;
+            std::cout << threadCount << " threads: " << frameTime << " ms per frame for " << DrawCount << " draws, speedup " << singleThreadTime / frameTime << "x, vertex buffer binds issued " << bindStatistics.vertexBuffers.issued << " skipped " << bindStatistics.vertexBuffers.skipped << '\n';
+        }
+    }
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+}
@@ -0,0 +1,279 @@
+#include "vallocator.h"
+#include "vbuffer.h"
+#include "vcommandbuffer.h"
+#include "vdescriptorsetlayout.h"
+#include "vdevice.h"
+#include "vfence.h"
+#include "vhostallocator.h"
+#include "vpipeline.h"
+#include "vpipelinelayout.h"
+#include "vsemaphore.h"
+#include "vshadermodule.h"
+#include "vspritebatch.h"
+#include "vsurface.h"
+#include "vswapchain.h"
+#include "vthreadcommandpools.h"
+
+#include "shaders/test_frag.h"
+#include "shaders/test_sprites_vert.h"
+
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+// Draws a few hundred thousand spinning sprites through SpriteBatch, regenerating all of them
+// on the CPU every frame.
+
+class VulkanRenderer : private NonCopyable
+{
+public:
+    explicit VulkanRenderer(GLFWwindow *window, int width, int height);
+    ~VulkanRenderer();
+
+    void render();
+    void dumpStatistics();
+
+private:
+    static constexpr uint32_t SpriteCount = 200000;
+
+    void updateSprites(float time);
+
+    GLFWwindow *m_window;
+    std::unique_ptr<V::Device> m_device;
+    std::unique_ptr<V::Surface> m_surface;
+    std::unique_ptr<V::Swapchain> m_swapchain;
+    std::unique_ptr<V::ShaderModule> m_vertexShaderModule;
+    std::unique_ptr<V::ShaderModule> m_fragmentShaderModule;
+    std::unique_ptr<V::SpriteBatch> m_spriteBatch;
+    std::unique_ptr<V::PipelineLayout> m_pipelineLayout;
+    std::unique_ptr<V::Pipeline> m_pipeline;
+    std::unique_ptr<V::ThreadCommandPools> m_commandPools;
+    std::unique_ptr<V::Semaphore> m_imageAvailableSemaphore;
+    std::unique_ptr<V::Semaphore> m_renderFinishedSemaphore;
+    std::vector<std::unique_ptr<V::Fence>> m_frameFences;
+
+    // sprite parameters, one array per attribute
+    std::vector<float> m_spriteX;
+    std::vector<float> m_spriteY;
+    std::vector<float> m_spriteSize;
+    std::vector<float> m_spriteSpin;
+    std::vector<uint32_t> m_spriteColor;
+
+    std::chrono::duration<double, std::milli> m_spriteTime { 0 };
+    int m_frameCount = 0;
+};
+
+VulkanRenderer::VulkanRenderer(GLFWwindow *window, int width, int height)
+    : m_window(window)
+    , m_device(new V::Device(std::make_unique<V::HostAllocator>(), "pipeline_cache.bin"))
+    , m_surface(m_device->createSurface(window))
+    , m_swapchain(m_surface->createSwapchain(width, height, 3))
+    , m_vertexShaderModule(m_device->createShaderModule(test_sprites_vert))
+    , m_fragmentShaderModule(m_device->createShaderModule(test_frag))
+    , m_imageAvailableSemaphore(m_device->createSemaphore())
+    , m_renderFinishedSemaphore(m_device->createSemaphore())
+{
+    const auto backbufferCount = m_swapchain->backbufferCount();
+
+    m_spriteBatch = std::make_unique<V::SpriteBatch>(m_device.get(), backbufferCount, SpriteCount);
+
+    m_pipelineLayout = m_device->pipelineLayoutBuilder().addSetLayout(m_spriteBatch->instanceSetLayout()).create();
+
+    m_pipeline = m_device->pipelineBuilder()
+                         .addShaderStage(VK_SHADER_STAGE_VERTEX_BIT, m_vertexShaderModule.get())
+                         .addShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, m_fragmentShaderModule.get())
+                         .create(m_pipelineLayout.get(), m_swapchain->renderPass());
+
+    m_commandPools = std::make_unique<V::ThreadCommandPools>(m_device.get(), 1, backbufferCount);
+
+    m_frameFences.reserve(backbufferCount);
+    for (size_t i = 0; i < backbufferCount; ++i)
+        m_frameFences.push_back(m_device->createFence(true));
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> positionDistribution(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> sizeDistribution(0.005f, 0.02f);
+    std::uniform_real_distribution<float> spinDistribution(-3.0f, 3.0f);
+    std::uniform_int_distribution<uint32_t> colorDistribution(0, 0xffffff);
+    for (uint32_t i = 0; i < SpriteCount; ++i) {
+        m_spriteX.push_back(positionDistribution(rng));
+        m_spriteY.push_back(positionDistribution(rng));
+        m_spriteSize.push_back(sizeDistribution(rng));
+        m_spriteSpin.push_back(spinDistribution(rng));
+        m_spriteColor.push_back(0xff000000 | colorDistribution(rng));
+    }
+    m_spriteBatch->batch(m_pipeline.get())->reserve(SpriteCount);
+}
+
+VulkanRenderer::~VulkanRenderer()
+{
+    for (auto &fence : m_frameFences)
+        fence->wait();
+}
+
+void VulkanRenderer::updateSprites(float time)
+{
+    auto *batch = m_spriteBatch->batch(m_pipeline.get());
+    for (uint32_t i = 0; i < SpriteCount; ++i)
+        batch->add(m_spriteX[i], m_spriteY[i], m_spriteSize[i], m_spriteSize[i], time * m_spriteSpin[i], m_spriteColor[i]);
+}
+
+void VulkanRenderer::render()
+{
+    // a resize recreates the swapchain and its framebuffers, the pipelines do not depend on the size
+    int width, height;
+    glfwGetFramebufferSize(m_window, &width, &height);
+    if (width == 0 || height == 0)
+        return; // minimized
+    if (m_swapchain->needsResize(width, height)) {
+        m_device->waitIdle();
+        m_swapchain->resize(width, height);
+    }
+
+    uint32_t imageIndex = m_swapchain->acquireNextImage(m_imageAvailableSemaphore.get());
+
+    // waits for the frame's previous submission, which read the same instance data
+    m_spriteBatch->beginFrame(imageIndex, m_frameFences[imageIndex].get());
+    m_frameFences[imageIndex]->reset();
+
+    const auto start = std::chrono::steady_clock::now();
+    updateSprites(static_cast<float>(glfwGetTime()));
+    m_spriteBatch->endFrame();
+    m_device->flushMappedMemoryRanges();
+    m_spriteTime += std::chrono::steady_clock::now() - start;
+    ++m_frameCount;
+
+    m_commandPools->beginFrame(imageIndex);
+    auto *commandBuffer = m_commandPools->commandBuffer(0);
+
+    const VkRect2D renderArea = {
+        .offset = VkOffset2D { 0, 0 },
+        .extent = VkExtent2D { m_swapchain->width(), m_swapchain->height() }
+    };
+    commandBuffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    commandBuffer->beginRenderPass(m_swapchain->renderPass(), m_swapchain->framebuffers()[imageIndex], renderArea);
+    commandBuffer->setViewportAndScissor(renderArea);
+    m_spriteBatch->record(commandBuffer, m_pipelineLayout.get());
+    commandBuffer->endRenderPass();
+    commandBuffer->end();
+
+    const VkCommandBuffer commandBufferHandle = commandBuffer->handle();
+    const VkSemaphore imageAvailable = m_imageAvailableSemaphore->handle();
+    const VkSemaphore renderFinished = m_renderFinishedSemaphore->handle();
+    const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+    VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &imageAvailable,
+        .pWaitDstStageMask = &waitStage,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &commandBufferHandle,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &renderFinished
+    };
+    if (vkQueueSubmit(m_device->queue(), 1, &submitInfo, m_frameFences[imageIndex]->handle()) != VK_SUCCESS)
+        throw std::runtime_error("Failed to submit command");
+
+    m_swapchain->queuePresent(imageIndex, m_renderFinishedSemaphore.get());
+}
+
+void VulkanRenderer::dumpStatistics()
+{
+    if (m_frameCount > 0)
+        std::cout << SpriteCount << " sprites generated and packed in " << m_spriteTime.count() / m_frameCount << " ms per frame\n";
+    m_spriteTime = {};
+    m_frameCount = 0;
+    std::cout << m_device->memoryStatistics().toJson() << '\n';
+}
+
+class Demo
+{
+public:
+    Demo();
+    ~Demo();
+
+    void initialize(int width, int height, const char *title);
+    void terminate();
+
+    void renderLoop();
+
+private:
+    static void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods);
+    void keyEvent(int key, int scancode, int action, int mods);
+
+    GLFWwindow *m_window = nullptr;
+    std::unique_ptr<VulkanRenderer> m_renderer;
+};
+
+Demo::Demo()
+{
+    glfwInit();
+    glfwSetErrorCallback([](int error, const char *description) {
+        std::cerr << "GLFW error " << error << ": " << description << '\n';
+    });
+}
+
+Demo::~Demo()
+{
+    terminate();
+}
+
+void Demo::initialize(int width, int height, const char *title)
+{
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    m_window = glfwCreateWindow(width, height, title, nullptr, nullptr);
+    glfwSetWindowUserPointer(m_window, this);
+    glfwSetKeyCallback(m_window, Demo::keyCallback);
+
+    m_renderer.reset(new VulkanRenderer(m_window, width, height));
+}
+
+void Demo::terminate()
+{
+    m_renderer.reset();
+
+    glfwDestroyWindow(m_window);
+    glfwTerminate();
+}
+
+void Demo::renderLoop()
+{
+    constexpr double StatisticsInterval = 10.0; // seconds
+
+    double lastStatisticsTime = glfwGetTime();
+    while (!glfwWindowShouldClose(m_window)) {
+        m_renderer->render();
+        glfwPollEvents();
+
+        const double time = glfwGetTime();
+        if (time - lastStatisticsTime >= StatisticsInterval) {
+            m_renderer->dumpStatistics();
+            lastStatisticsTime = time;
+        }
+    }
+}
+
+void Demo::keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+    auto *demo = reinterpret_cast<Demo *>(glfwGetWindowUserPointer(window));
+    demo->keyEvent(key, scancode, action, mods);
+}
+
+void Demo::keyEvent(int key, int scancode, int action, int mods)
+{
+    if (action == GLFW_PRESS && key == GLFW_KEY_ESCAPE)
+        glfwSetWindowShouldClose(m_window, 1);
+}
+
+int main()
+{
+    Demo demo;
+    demo.initialize(1200, 600, "sprites");
+    demo.renderLoop();
+}
@@ -0,0 +1,37 @@
+#version 450
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+layout(location=0) out vec4 fragColor;
+
+layout(set=0, binding=0) readonly buffer RectBuffer
+{
+    vec4 rects[]; // center, size
+} rectBuffer;
+
+layout(set=0, binding=1) readonly buffer RotationBuffer
+{
+    float rotations[];
+} rotationBuffer;
+
+layout(set=0, binding=2) readonly buffer ColorBuffer
+{
+    uint colors[];
+} colorBuffer;
+
+const vec2 corners[6] = vec2[](
+    vec2(-0.5, -0.5), vec2(0.5, -0.5), vec2(0.5, 0.5),
+    vec2(-0.5, -0.5), vec2(0.5, 0.5), vec2(-0.5, 0.5));
+
+void main()
+{
+    vec4 rect = rectBuffer.rects[gl_InstanceIndex];
+    float rotation = rotationBuffer.rotations[gl_InstanceIndex];
+    vec2 corner = corners[gl_VertexIndex] * rect.zw;
+    float c = cos(rotation);
+    float s = sin(rotation);
+    gl_Position = vec4(rect.xy + vec2(c * corner.x - s * corner.y, s * corner.x + c * corner.y), 0.0, 1.0);
+    fragColor = unpackUnorm4x8(colorBuffer.colors[gl_InstanceIndex]);
+}
@@ -1,18 +1,23 @@
+#include "vallocator.h"
 #include "vbuffer.h"
 #include "vcommandbuffer.h"
-#include "vcommandpool.h"
 #include "vdescriptorpool.h"
 #include "vdescriptorset.h"
 #include "vdescriptorsetlayout.h"
 #include "vdevice.h"
 #include "vfence.h"
-#include "vmemory.h"
+#include "vhostallocator.h"
 #include "vpipeline.h"
 #include "vpipelinelayout.h"
 #include "vsemaphore.h"
 #include "vshadermodule.h"
 #include "vsurface.h"
 #include "vswapchain.h"
+#include "vthreadcommandpools.h"
+#include "vuploader.h"
+
+#include "shaders/test_frag.h"
+#include "shaders/test_ssbo_vert.h"
 
 #include <GLFW/glfw3.h>
 
@@ -29,7 +34,8 @@ public:
     explicit VulkanRenderer(GLFWwindow *window, int width, int height);
     ~VulkanRenderer();
 
-    void render() const;
+    void render();
+    void dumpMemoryStatistics() const;
 
 private:
     GLFWwindow *m_window;
@@ -40,54 +46,50 @@ private:
     std::unique_ptr<V::ShaderModule> m_fragmentShaderModule;
     std::unique_ptr<V::PipelineLayout> m_pipelineLayout;
     std::unique_ptr<V::Pipeline> m_pipeline;
-    std::unique_ptr<V::CommandPool> m_commandPool;
+    std::unique_ptr<V::ThreadCommandPools> m_commandPools;
     std::unique_ptr<V::Semaphore> m_imageAvailableSemaphore;
     std::unique_ptr<V::Semaphore> m_renderFinishedSemaphore;
-    std::unique_ptr<V::Memory> m_memory;
-    std::unique_ptr<V::Buffer> m_positionBuffer;
-    std::unique_ptr<V::Buffer> m_colorBuffer;
+    std::unique_ptr<V::Buffer> m_vertexDataBuffer;
     std::unique_ptr<V::DescriptorSetLayout> m_descriptorSetLayout;
     std::unique_ptr<V::DescriptorPool> m_descriptorPool;
     std::unique_ptr<V::DescriptorSet> m_descriptorSet;
-    std::vector<std::unique_ptr<V::CommandBuffer>> m_commandBuffers;
     std::vector<std::unique_ptr<V::Fence>> m_frameFences;
 };
 
 VulkanRenderer::VulkanRenderer(GLFWwindow *window, int width, int height)
     : m_window(window)
-    , m_device(new V::Device)
+    , m_device(new V::Device(std::make_unique<V::HostAllocator>(), "pipeline_cache.bin"))
     , m_surface(m_device->createSurface(window))
     , m_swapchain(m_surface->createSwapchain(width, height, 3))
-    , m_vertexShaderModule(m_device->createShaderModule("test_ssbo.spv"))
-    , m_fragmentShaderModule(m_device->createShaderModule("test_frag.spv"))
-    , m_commandPool(m_device->createCommandPool())
+    , m_vertexShaderModule(m_device->createShaderModule(test_ssbo_vert))
+    , m_fragmentShaderModule(m_device->createShaderModule(test_frag))
     , m_imageAvailableSemaphore(m_device->createSemaphore())
     , m_renderFinishedSemaphore(m_device->createSemaphore())
-    , m_memory(m_device->allocateMemory(1024))
-    , m_positionBuffer(m_device->createBuffer(512, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT))
-    , m_colorBuffer(m_device->createBuffer(512, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT))
+    , m_vertexDataBuffer(m_device->createBuffer(1024, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, V::MemoryUsage::GpuOnly))
 {
-    m_positionBuffer->bindMemory(m_memory.get(), 0);
-    m_colorBuffer->bindMemory(m_memory.get(), 512);
+    // positions and colors live in two slices of the same buffer
+    const VkDeviceSize colorOffset = std::max<VkDeviceSize>(512, m_device->properties().limits.minStorageBufferOffsetAlignment);
+    const V::BufferSlice positionSlice(m_vertexDataBuffer.get(), 0, colorOffset);
+    const V::BufferSlice colorSlice(m_vertexDataBuffer.get(), colorOffset, m_vertexDataBuffer->size() - colorOffset);
 
     {
-        float *buffer = m_memory->map<float>();
-
-        float *positions = buffer;
-        // clang-format off
-        positions[ 0] =  0.0; positions[ 1]  = -0.5; positions[ 2] = 0.0; positions[ 3] = 1.0;
-        positions[ 4] =  0.5; positions[ 5]  =  0.5; positions[ 6] = 0.0; positions[ 7] = 1.0;
-        positions[ 8] = -0.5; positions[ 9]  =  0.5; positions[10] = 0.0; positions[11] = 1.0;
-        // clang-format on
-
-        float *colors = &buffer[512 / sizeof(float)];
         // clang-format off
-        colors[ 0] = 1.0; colors[ 1]  = 0.0; colors[ 2] = 0.0; colors[ 3] = 1.0;
-        colors[ 4] = 1.0; colors[ 5]  = 1.0; colors[ 6] = 0.0; colors[ 7] = 1.0;
-        colors[ 8] = 1.0; colors[ 9]  = 0.0; colors[10] = 1.0; colors[11] = 1.0;
+        static const float positions[] = {
+             0.0, -0.5, 0.0, 1.0,
+             0.5,  0.5, 0.0, 1.0,
+            -0.5,  0.5, 0.0, 1.0,
+        };
+        static const float colors[] = {
+            1.0, 0.0, 0.0, 1.0,
+            1.0, 1.0, 0.0, 1.0,
+            1.0, 0.0, 1.0, 1.0,
+        };
         // clang-format on
 
-        m_memory->unmap();
+        V::Uploader uploader(m_device.get());
+        uploader.upload(m_vertexDataBuffer.get(), positionSlice.offset, positions, sizeof(positions));
+        uploader.upload(m_vertexDataBuffer.get(), colorSlice.offset, colors, sizeof(colors));
+        uploader.wait(uploader.submit());
     }
 
     m_descriptorSetLayout = m_device->descriptorSetLayoutBuilder()
@@ -100,37 +102,20 @@ VulkanRenderer::VulkanRenderer(GLFWwindow *window, int width, int height)
                                .create();
 
     m_descriptorSet = m_descriptorPool->allocateDescriptorSet(m_descriptorSetLayout.get());
-    m_descriptorSet->writeBuffer(0, m_positionBuffer.get());
-    m_descriptorSet->writeBuffer(1, m_colorBuffer.get());
+    m_descriptorSet->writeBuffer(0, positionSlice);
+    m_descriptorSet->writeBuffer(1, colorSlice);
 
     m_pipelineLayout = m_device->pipelineLayoutBuilder().addSetLayout(m_descriptorSetLayout.get()).create();
 
     m_pipeline = m_device->pipelineBuilder()
-                         .setViewport(m_swapchain->width(), m_swapchain->height())
                          .addShaderStage(VK_SHADER_STAGE_VERTEX_BIT, m_vertexShaderModule.get())
                          .addShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, m_fragmentShaderModule.get())
                          .create(m_pipelineLayout.get(), m_swapchain->renderPass());
 
     const auto backbufferCount = m_swapchain->backbufferCount();
 
-    const auto renderPass = m_swapchain->renderPass();
-    const auto &framebuffers = m_swapchain->framebuffers();
-    m_commandBuffers.reserve(backbufferCount);
-    const VkRect2D renderArea = {
-        .offset = VkOffset2D { 0, 0 },
-        .extent = VkExtent2D { m_swapchain->width(), m_swapchain->height() }
-    };
-    for (size_t i = 0; i < backbufferCount; ++i) {
-        auto commandBuffer = m_commandPool->allocateCommandBuffer();
-        commandBuffer->begin();
-        commandBuffer->beginRenderPass(renderPass, framebuffers[i], renderArea);
-        commandBuffer->bindPipeline(m_pipeline.get());
-        commandBuffer->bindDescriptorSet(m_pipelineLayout.get(), m_descriptorSet.get());
-        commandBuffer->draw(3, 1, 0, 0);
-        commandBuffer->endRenderPass();
-        commandBuffer->end();
-        m_commandBuffers.push_back(std::move(commandBuffer));
-    }
+    // command buffers are recorded every frame from the pools of the backbuffer being rendered
+    m_commandPools = std::make_unique<V::ThreadCommandPools>(m_device.get(), 1, backbufferCount);
 
     m_frameFences.reserve(backbufferCount);
     for (size_t i = 0; i < backbufferCount; ++i)
@@ -143,14 +128,41 @@ VulkanRenderer::~VulkanRenderer()
         fence->wait();
 }
 
-void VulkanRenderer::render() const
+void VulkanRenderer::render()
 {
+    // a resize recreates the swapchain and its framebuffers, the pipelines do not depend on the size
+    int width, height;
+    glfwGetFramebufferSize(m_window, &width, &height);
+    if (width == 0 || height == 0)
+        return; // minimized
+    if (m_swapchain->needsResize(width, height)) {
+        m_device->waitIdle();
+        m_swapchain->resize(width, height);
+    }
+
     uint32_t imageIndex = m_swapchain->acquireNextImage(m_imageAvailableSemaphore.get());
 
     m_frameFences[imageIndex]->wait();
     m_frameFences[imageIndex]->reset();
 
-    const VkCommandBuffer commandBuffer = m_commandBuffers[imageIndex]->handle();
+    // the frame's previous command buffers have completed, so its pool can be reset and reused
+    m_commandPools->beginFrame(imageIndex);
+    auto *commandBuffer = m_commandPools->commandBuffer(0);
+
+    const VkRect2D renderArea = {
+        .offset = VkOffset2D { 0, 0 },
+        .extent = VkExtent2D { m_swapchain->width(), m_swapchain->height() }
+    };
+    commandBuffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    commandBuffer->beginRenderPass(m_swapchain->renderPass(), m_swapchain->framebuffers()[imageIndex], renderArea);
+    commandBuffer->setViewportAndScissor(renderArea);
+    commandBuffer->bindPipeline(m_pipeline.get());
+    commandBuffer->bindDescriptorSet(m_pipelineLayout.get(), m_descriptorSet.get());
+    commandBuffer->draw(3, 1, 0, 0);
+    commandBuffer->endRenderPass();
+    commandBuffer->end();
+
+    const VkCommandBuffer commandBufferHandle = commandBuffer->handle();
     const VkSemaphore imageAvailable = m_imageAvailableSemaphore->handle();
     const VkSemaphore renderFinished = m_renderFinishedSemaphore->handle();
     const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
@@ -161,7 +173,7 @@ void VulkanRenderer::render() const
         .pWaitSemaphores = &imageAvailable,
         .pWaitDstStageMask = &waitStage,
         .commandBufferCount = 1,
-        .pCommandBuffers = &commandBuffer,
+        .pCommandBuffers = &commandBufferHandle,
         .signalSemaphoreCount = 1,
         .pSignalSemaphores = &renderFinished
     };
@@ -171,6 +183,13 @@ void VulkanRenderer::render() const
     m_swapchain->queuePresent(imageIndex, m_renderFinishedSemaphore.get());
 }
 
+void VulkanRenderer::dumpMemoryStatistics() const
+{
+    std::cout << m_device->memoryStatistics().toJson() << '\n';
+    if (const auto *hostAllocator = m_device->hostAllocator())
+        std::cout << hostAllocator->statistics().toJson() << '\n';
+}
+
 class Demo
 {
 public:
@@ -223,9 +242,18 @@ void Demo::terminate()
 
 void Demo::renderLoop()
 {
+    constexpr double MemoryStatisticsInterval = 10.0; // seconds
+
+    double lastMemoryStatisticsTime = glfwGetTime();
     while (!glfwWindowShouldClose(m_window)) {
         m_renderer->render();
         glfwPollEvents();
+
+        const double time = glfwGetTime();
+        if (time - lastMemoryStatisticsTime >= MemoryStatisticsInterval) {
+            m_renderer->dumpMemoryStatistics();
+            lastMemoryStatisticsTime = time;
+        }
     }
 }
 
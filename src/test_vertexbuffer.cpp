@@ -1,35 +1,81 @@
+#include "vallocator.h"
 #include "vbuffer.h"
 #include "vcommandbuffer.h"
-#include "vcommandpool.h"
 #include "vdescriptorpool.h"
 #include "vdescriptorset.h"
 #include "vdescriptorsetlayout.h"
 #include "vdevice.h"
 #include "vfence.h"
-#include "vmemory.h"
+#include "vhostallocator.h"
 #include "vpipeline.h"
 #include "vpipelinelayout.h"
+#include "vringbuffer.h"
 #include "vsemaphore.h"
 #include "vshadermodule.h"
 #include "vsurface.h"
 #include "vswapchain.h"
+#include "vthreadcommandpools.h"
+#include "vuploader.h"
+
+#include "shaders/test_frag.h"
+#include "shaders/test_vertexbuffer_vert.h"
 
 #include <GLFW/glfw3.h>
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <iterator>
 #include <memory>
+#include <new>
 #include <vector>
 
+namespace {
+
+// every global operator new, so the renderer can check that recording a frame doesn't allocate
+std::atomic<size_t> operatorNewCount = 0;
+
+struct Vertex {
+    float x, y, z, w;
+    float r, g, b, a;
+};
+
+// matches the push constant block of test_vertexbuffer.vert
+struct PushConstants {
+    float x, y, z, w; // offset added to the vertex positions
+};
+
+} // namespace
+
+void *operator new(size_t size)
+{
+    ++operatorNewCount;
+    if (void *memory = std::malloc(size ? size : 1))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+    std::free(memory);
+}
+
 class VulkanRenderer : private NonCopyable
 {
 public:
     explicit VulkanRenderer(GLFWwindow *window, int width, int height);
     ~VulkanRenderer();
 
-    void render() const;
+    void render();
+    void dumpMemoryStatistics() const;
 
 private:
     GLFWwindow *m_window;
@@ -40,79 +86,57 @@ private:
     std::unique_ptr<V::ShaderModule> m_fragmentShaderModule;
     std::unique_ptr<V::PipelineLayout> m_pipelineLayout;
     std::unique_ptr<V::Pipeline> m_pipeline;
-    std::unique_ptr<V::CommandPool> m_commandPool;
+    std::unique_ptr<V::ThreadCommandPools> m_commandPools;
     std::unique_ptr<V::Semaphore> m_imageAvailableSemaphore;
     std::unique_ptr<V::Semaphore> m_renderFinishedSemaphore;
-    std::unique_ptr<V::Memory> m_memory;
     std::unique_ptr<V::Buffer> m_vertexBuffer;
-    std::vector<std::unique_ptr<V::CommandBuffer>> m_commandBuffers;
+    std::unique_ptr<V::RingBuffer> m_ringBuffer; // vertices written every frame
     std::vector<std::unique_ptr<V::Fence>> m_frameFences;
+    std::vector<bool> m_recordedImages; // images whose command buffer has been allocated
 };
 
 VulkanRenderer::VulkanRenderer(GLFWwindow *window, int width, int height)
     : m_window(window)
-    , m_device(new V::Device)
+    , m_device(new V::Device(std::make_unique<V::HostAllocator>(), "pipeline_cache.bin"))
     , m_surface(m_device->createSurface(window))
     , m_swapchain(m_surface->createSwapchain(width, height, 3))
-    , m_vertexShaderModule(m_device->createShaderModule("test_vertexbuffer.spv"))
-    , m_fragmentShaderModule(m_device->createShaderModule("test_frag.spv"))
-    , m_commandPool(m_device->createCommandPool())
+    , m_vertexShaderModule(m_device->createShaderModule(test_vertexbuffer_vert))
+    , m_fragmentShaderModule(m_device->createShaderModule(test_frag))
     , m_imageAvailableSemaphore(m_device->createSemaphore())
     , m_renderFinishedSemaphore(m_device->createSemaphore())
-    , m_memory(m_device->allocateMemory(1024))
-    , m_vertexBuffer(m_device->createBuffer(1024, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT))
+    , m_vertexBuffer(m_device->createBuffer(1024, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, V::MemoryUsage::GpuOnly))
 {
-    struct Vertex {
-        float x, y, z, w;
-        float r, g, b, a;
-    };
-    m_vertexBuffer->bindMemory(m_memory.get(), 0);
     {
         static const std::vector<Vertex> vertices = {
             { 0, -.5, 0, 1, 1, 0, 0, 1 },
             { .5, .5, 0, 1, 1, 1, 0, 1 },
             { -.5, .5, 0, 1, 1, 1, 1, 1 },
         };
-        uint8_t *data = m_memory->map<uint8_t>();
-        std::memcpy(data, vertices.data(), vertices.size() * sizeof(Vertex));
-        m_memory->unmap();
+        V::Uploader uploader(m_device.get());
+        uploader.upload(m_vertexBuffer.get(), 0, vertices.data(), vertices.size() * sizeof(Vertex));
+        uploader.wait(uploader.submit());
     }
 
-    m_pipelineLayout = m_device->pipelineLayoutBuilder().create();
+    m_pipelineLayout = m_device->pipelineLayoutBuilder().addPushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstants)).create();
 
     m_pipeline = m_device->pipelineBuilder()
                          .addVertexInputBinding(0, sizeof(Vertex))
                          .addVertexInputAttribute(0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 0) // location 0
                          .addVertexInputAttribute(1, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 4 * sizeof(float)) // location 1
-                         .setViewport(m_swapchain->width(), m_swapchain->height())
                          .addShaderStage(VK_SHADER_STAGE_VERTEX_BIT, m_vertexShaderModule.get())
                          .addShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, m_fragmentShaderModule.get())
                          .create(m_pipelineLayout.get(), m_swapchain->renderPass());
 
     const auto backbufferCount = m_swapchain->backbufferCount();
 
-    const auto renderPass = m_swapchain->renderPass();
-    const auto &framebuffers = m_swapchain->framebuffers();
-    m_commandBuffers.reserve(backbufferCount);
-    const VkRect2D renderArea = {
-        .offset = VkOffset2D { 0, 0 },
-        .extent = VkExtent2D { m_swapchain->width(), m_swapchain->height() }
-    };
-    for (size_t i = 0; i < backbufferCount; ++i) {
-        auto commandBuffer = m_commandPool->allocateCommandBuffer();
-        commandBuffer->begin();
-        commandBuffer->beginRenderPass(renderPass, framebuffers[i], renderArea);
-        commandBuffer->bindPipeline(m_pipeline.get());
-        commandBuffer->bindVertexBuffers({ m_vertexBuffer.get() });
-        commandBuffer->draw(3, 1, 0, 0);
-        commandBuffer->endRenderPass();
-        commandBuffer->end();
-        m_commandBuffers.push_back(std::move(commandBuffer));
-    }
+    // command buffers are recorded every frame from the pools of the backbuffer being rendered
+    m_commandPools = std::make_unique<V::ThreadCommandPools>(m_device.get(), 1, backbufferCount);
+    m_ringBuffer = std::make_unique<V::RingBuffer>(m_device.get(), 3 * sizeof(Vertex), backbufferCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
 
     m_frameFences.reserve(backbufferCount);
     for (size_t i = 0; i < backbufferCount; ++i)
         m_frameFences.push_back(m_device->createFence(true));
+    m_recordedImages.resize(backbufferCount);
 }
 
 VulkanRenderer::~VulkanRenderer()
@@ -121,14 +145,64 @@ VulkanRenderer::~VulkanRenderer()
         fence->wait();
 }
 
-void VulkanRenderer::render() const
+void VulkanRenderer::render()
 {
+    // a resize recreates the swapchain and its framebuffers, the pipelines do not depend on the size
+    int width, height;
+    glfwGetFramebufferSize(m_window, &width, &height);
+    if (width == 0 || height == 0)
+        return; // minimized
+    if (m_swapchain->needsResize(width, height)) {
+        m_device->waitIdle();
+        m_swapchain->resize(width, height);
+    }
+
     uint32_t imageIndex = m_swapchain->acquireNextImage(m_imageAvailableSemaphore.get());
 
-    m_frameFences[imageIndex]->wait();
+    // waits for the frame's previous submission, which read the same ring buffer partition
+    m_ringBuffer->beginFrame(imageIndex, m_frameFences[imageIndex].get());
     m_frameFences[imageIndex]->reset();
 
-    const VkCommandBuffer commandBuffer = m_commandBuffers[imageIndex]->handle();
+    // the frame's previous command buffers have completed, so its pool can be reset and reused
+    const size_t startOperatorNewCount = operatorNewCount;
+    m_commandPools->beginFrame(imageIndex);
+    auto *commandBuffer = m_commandPools->commandBuffer(0);
+
+    // a second, spinning triangle whose vertices are streamed through the ring buffer
+    const float time = glfwGetTime();
+    V::BufferSlice streamedVertices(nullptr);
+    auto *vertices = m_ringBuffer->allocate<Vertex>(3, &streamedVertices);
+    for (int i = 0; i < 3; ++i) {
+        const float angle = time + i * 2.0943951f;
+        vertices[i] = Vertex { .2f * std::cos(angle), .2f * std::sin(angle), 0, 1, 0, 1, i * .5f, 1 };
+    }
+
+    const VkRect2D renderArea = {
+        .offset = VkOffset2D { 0, 0 },
+        .extent = VkExtent2D { m_swapchain->width(), m_swapchain->height() }
+    };
+    commandBuffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    commandBuffer->beginRenderPass(m_swapchain->renderPass(), m_swapchain->framebuffers()[imageIndex], renderArea);
+    commandBuffer->setViewportAndScissor(renderArea);
+    commandBuffer->bindPipeline(m_pipeline.get());
+    commandBuffer->bindVertexBuffers({ m_vertexBuffer.get() });
+    commandBuffer->pushConstants(m_pipelineLayout.get(), VK_SHADER_STAGE_VERTEX_BIT, PushConstants { .25f * std::cos(time), .25f * std::sin(time), 0, 0 });
+    commandBuffer->draw(3, 1, 0, 0);
+    commandBuffer->bindVertexBuffer(0, streamedVertices);
+    commandBuffer->pushConstants(m_pipelineLayout.get(), VK_SHADER_STAGE_VERTEX_BIT, PushConstants { 0, 0, 0, 0 });
+    commandBuffer->draw(3, 1, 0, 0);
+    commandBuffer->endRenderPass();
+    commandBuffer->end();
+
+    // once the command buffer for this image exists, recording must not touch the heap
+    if (m_recordedImages[imageIndex] && operatorNewCount != startOperatorNewCount)
+        throw std::runtime_error("Recording a frame allocated memory");
+    m_recordedImages[imageIndex] = true;
+
+    m_ringBuffer->flush();
+    m_device->flushMappedMemoryRanges();
+
+    const VkCommandBuffer commandBufferHandle = commandBuffer->handle();
     const VkSemaphore imageAvailable = m_imageAvailableSemaphore->handle();
     const VkSemaphore renderFinished = m_renderFinishedSemaphore->handle();
     const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
@@ -139,7 +213,7 @@ void VulkanRenderer::render() const
         .pWaitSemaphores = &imageAvailable,
         .pWaitDstStageMask = &waitStage,
         .commandBufferCount = 1,
-        .pCommandBuffers = &commandBuffer,
+        .pCommandBuffers = &commandBufferHandle,
         .signalSemaphoreCount = 1,
         .pSignalSemaphores = &renderFinished
     };
@@ -149,6 +223,13 @@ void VulkanRenderer::render() const
     m_swapchain->queuePresent(imageIndex, m_renderFinishedSemaphore.get());
 }
 
+void VulkanRenderer::dumpMemoryStatistics() const
+{
+    std::cout << m_device->memoryStatistics().toJson() << '\n';
+    if (const auto *hostAllocator = m_device->hostAllocator())
+        std::cout << hostAllocator->statistics().toJson() << '\n';
+}
+
 class Demo
 {
 public:
@@ -201,9 +282,18 @@ void Demo::terminate()
 
 void Demo::renderLoop()
 {
+    constexpr double MemoryStatisticsInterval = 10.0; // seconds
+
+    double lastMemoryStatisticsTime = glfwGetTime();
     while (!glfwWindowShouldClose(m_window)) {
         m_renderer->render();
         glfwPollEvents();
+
+        const double time = glfwGetTime();
+        if (time - lastMemoryStatisticsTime >= MemoryStatisticsInterval) {
+            m_renderer->dumpMemoryStatistics();
+            lastMemoryStatisticsTime = time;
+        }
     }
 }
 
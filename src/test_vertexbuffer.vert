@@ -1,7 +1,5 @@
 #version 450
 
-// compile with glslangValidator -V -o test_vertexbuffer.spv test_vertexbuffer.vert
-
 out gl_PerVertex {
     vec4 gl_Position;
 };
@@ -11,8 +9,13 @@ layout(location=1) in vec4 inColor;
 
 layout(location=0) out vec4 fragColor;
 
+layout(push_constant) uniform PushConstants
+{
+    vec4 offset;
+} pushConstants;
+
 void main()
 {
-    gl_Position = inPosition;
+    gl_Position = inPosition + pushConstants.offset;
     fragColor = inColor;
 }
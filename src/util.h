@@ -1,6 +1,20 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <vector>
 
 std::vector<uint8_t> readFile(const char *path);
+
+template<typename T>
+T alignUp(T value, T alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+template<typename T>
+void hashCombine(std::size_t &seed, const T &value)
+{
+    seed ^= std::hash<T>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
@@ -0,0 +1,438 @@
+#include "vallocator.h"
+
+#include "util.h"
+#include "vmemory.h"
+
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+
+namespace V {
+
+void MemoryStatistics::Usage::add(const Usage &other)
+{
+    blockCount += other.blockCount;
+    dedicatedBlockCount += other.dedicatedBlockCount;
+    allocationCount += other.allocationCount;
+    blockBytes += other.blockBytes;
+    allocationBytes += other.allocationBytes;
+    freeRangeCount += other.freeRangeCount;
+    largestFreeRange = std::max(largestFreeRange, other.largestFreeRange);
+}
+
+namespace {
+
+// sorts the ranges and merges the ones that overlap or touch, so each byte is passed to the driver once
+void mergeMappedRanges(std::vector<VkMappedMemoryRange> &ranges)
+{
+    std::sort(ranges.begin(), ranges.end(), [](const VkMappedMemoryRange &a, const VkMappedMemoryRange &b) {
+        return std::tie(a.memory, a.offset) < std::tie(b.memory, b.offset);
+    });
+
+    size_t count = 0;
+    for (const auto &range : ranges) {
+        if (count > 0) {
+            auto &last = ranges[count - 1];
+            if (last.memory == range.memory && last.offset + last.size >= range.offset) {
+                last.size = std::max(last.offset + last.size, range.offset + range.size) - last.offset;
+                continue;
+            }
+        }
+        ranges[count++] = range;
+    }
+    ranges.resize(count);
+}
+
+void writeUsage(std::ostream &out, const MemoryStatistics::Usage &usage)
+{
+    out << "{\"blockCount\": " << usage.blockCount
+        << ", \"dedicatedBlockCount\": " << usage.dedicatedBlockCount
+        << ", \"allocationCount\": " << usage.allocationCount
+        << ", \"blockBytes\": " << usage.blockBytes
+        << ", \"allocationBytes\": " << usage.allocationBytes
+        << ", \"freeBytes\": " << usage.blockBytes - usage.allocationBytes
+        << ", \"freeRangeCount\": " << usage.freeRangeCount
+        << ", \"largestFreeRange\": " << usage.largestFreeRange << "}";
+}
+
+} // namespace
+
+std::string MemoryStatistics::toJson() const
+{
+    std::ostringstream out;
+    out << "{\"total\": ";
+    writeUsage(out, total);
+    out << ", \"heaps\": [";
+    for (size_t i = 0; i < heaps.size(); ++i) {
+        const auto &heap = heaps[i];
+        out << (i > 0 ? ", " : "") << "{\"index\": " << i << ", \"size\": " << heap.size << ", \"flags\": " << heap.flags << ", \"usage\": ";
+        writeUsage(out, heap.usage);
+        if (hasBudget)
+            out << ", \"budget\": " << heap.budget << ", \"budgetUsage\": " << heap.budgetUsage;
+        out << "}";
+    }
+    out << "], \"types\": [";
+    for (size_t i = 0; i < types.size(); ++i) {
+        const auto &type = types[i];
+        out << (i > 0 ? ", " : "") << "{\"index\": " << i << ", \"heapIndex\": " << type.heapIndex << ", \"propertyFlags\": " << type.propertyFlags << ", \"usage\": ";
+        writeUsage(out, type.usage);
+        out << "}";
+    }
+    out << "]}";
+    return out.str();
+}
+
+Allocation::Allocation(MemoryBlock *block, VkDeviceSize offset, VkDeviceSize size)
+    : m_block(block)
+    , m_offset(offset)
+    , m_size(size)
+{
+}
+
+Allocation::~Allocation()
+{
+    m_block->allocator()->free(this);
+}
+
+const Memory *Allocation::memory() const
+{
+    return m_block->memory();
+}
+
+void Allocation::flush(VkDeviceSize offset, VkDeviceSize size) const
+{
+    memory()->flush(m_offset + offset, size == VK_WHOLE_SIZE ? m_size - offset : size);
+}
+
+void Allocation::invalidate(VkDeviceSize offset, VkDeviceSize size) const
+{
+    memory()->invalidate(m_offset + offset, size == VK_WHOLE_SIZE ? m_size - offset : size);
+}
+
+void *Allocation::mapData() const
+{
+    return m_block->memory()->map<void>(m_offset);
+}
+
+MemoryBlock::MemoryBlock(Allocator *allocator, uint32_t memoryTypeIndex, VkDeviceSize size, bool dedicated, VkBuffer dedicatedBuffer)
+    : m_allocator(allocator)
+    , m_memoryTypeIndex(memoryTypeIndex)
+    , m_dedicated(dedicated)
+{
+    VkMemoryDedicatedAllocateInfoKHR memoryDedicatedAllocateInfo {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO_KHR,
+        .buffer = dedicatedBuffer
+    };
+    VkMemoryAllocateInfo memoryAllocateInfo {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = dedicatedBuffer != VK_NULL_HANDLE ? &memoryDedicatedAllocateInfo : nullptr,
+        .allocationSize = size,
+        .memoryTypeIndex = memoryTypeIndex
+    };
+    m_memory = std::make_unique<Memory>(m_allocator->device(), memoryAllocateInfo);
+
+    insertFreeRange(0, size);
+}
+
+MemoryBlock::~MemoryBlock()
+{
+    assert(m_allocations.empty());
+}
+
+VkDeviceSize MemoryBlock::size() const
+{
+    return m_memory->size();
+}
+
+VkDeviceSize MemoryBlock::largestFreeRange() const
+{
+    return m_freeRangesBySize.empty() ? 0 : m_freeRangesBySize.rbegin()->first;
+}
+
+std::unique_ptr<Allocation> MemoryBlock::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize endOffset)
+{
+    // best fit: smallest free range that can hold the request once its start is aligned
+    for (auto it = m_freeRangesBySize.lower_bound({ size, 0 }); it != m_freeRangesBySize.end(); ++it) {
+        const VkDeviceSize rangeSize = it->first;
+        const VkDeviceSize rangeOffset = it->second;
+
+        const VkDeviceSize alignedOffset = alignUp(rangeOffset, alignment);
+        const VkDeviceSize padding = alignedOffset - rangeOffset;
+        if (padding + size > rangeSize || (endOffset != VK_WHOLE_SIZE && alignedOffset + size > endOffset))
+            continue;
+
+        eraseFreeRange(rangeOffset, rangeSize);
+        if (padding > 0)
+            insertFreeRange(rangeOffset, padding);
+        if (padding + size < rangeSize)
+            insertFreeRange(alignedOffset + size, rangeSize - padding - size);
+
+        auto allocation = std::make_unique<Allocation>(this, alignedOffset, size);
+        m_allocations.emplace(alignedOffset, allocation.get());
+        m_allocatedSize += size;
+        return allocation;
+    }
+    return nullptr;
+}
+
+void MemoryBlock::free(const Allocation *allocation)
+{
+    assert(m_allocations.count(allocation->offset()) == 1);
+    m_allocations.erase(allocation->offset());
+    m_allocatedSize -= allocation->size();
+
+    VkDeviceSize offset = allocation->offset();
+    VkDeviceSize size = allocation->size();
+
+    // coalesce with the free ranges immediately after and before this one
+
+    auto next = m_freeRanges.lower_bound(offset);
+    if (next != m_freeRanges.end() && next->first == offset + size) {
+        size += next->second;
+        eraseFreeRange(next->first, next->second);
+    }
+
+    auto prev = m_freeRanges.lower_bound(offset);
+    if (prev != m_freeRanges.begin()) {
+        --prev;
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            size += prev->second;
+            eraseFreeRange(prev->first, prev->second);
+        }
+    }
+
+    insertFreeRange(offset, size);
+}
+
+void MemoryBlock::insertFreeRange(VkDeviceSize offset, VkDeviceSize size)
+{
+    m_freeRanges.emplace(offset, size);
+    m_freeRangesBySize.emplace(size, offset);
+}
+
+void MemoryBlock::eraseFreeRange(VkDeviceSize offset, VkDeviceSize size)
+{
+    m_freeRanges.erase(offset);
+    m_freeRangesBySize.erase({ size, offset });
+}
+
+Allocator::Allocator(const Device *device, VkDeviceSize blockSize)
+    : m_device(device)
+    , m_blockSize(blockSize)
+{
+}
+
+Allocator::~Allocator() = default;
+
+std::unique_ptr<Allocation> Allocator::allocate(const VkMemoryRequirements &requirements, uint32_t memoryTypeIndex)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto &blocks = m_blocks[memoryTypeIndex];
+
+    for (auto &block : blocks) {
+        if (block->isDedicated())
+            continue;
+        if (auto allocation = block->allocate(requirements.size, requirements.alignment))
+            return allocation;
+    }
+
+    // no room in the existing blocks, carve a new one (large requests get a block of their own size)
+    const VkDeviceSize blockSize = std::max(m_blockSize, requirements.size);
+    blocks.push_back(std::make_unique<MemoryBlock>(this, memoryTypeIndex, blockSize));
+
+    auto allocation = blocks.back()->allocate(requirements.size, requirements.alignment);
+    if (!allocation)
+        throw std::runtime_error("Failed to allocate memory from new block");
+    return allocation;
+}
+
+std::unique_ptr<Allocation> Allocator::allocateDedicated(const VkMemoryRequirements &requirements, uint32_t memoryTypeIndex, VkBuffer dedicatedBuffer)
+{
+    auto block = std::make_unique<MemoryBlock>(this, memoryTypeIndex, requirements.size, true, dedicatedBuffer);
+    auto allocation = block->allocate(requirements.size, requirements.alignment);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_blocks[memoryTypeIndex].push_back(std::move(block));
+    return allocation;
+}
+
+void Allocator::free(const Allocation *allocation)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    MemoryBlock *block = allocation->block();
+    block->free(allocation);
+
+    // memory that was allocated for a single resource goes straight back to the driver
+    if (block->isDedicated()) {
+        auto &blocks = m_blocks[block->memoryTypeIndex()];
+        releaseBlock(std::find_if(blocks.begin(), blocks.end(), [block](const std::unique_ptr<MemoryBlock> &other) {
+            return other.get() == block;
+        }));
+    }
+}
+
+void Allocator::releaseBlock(std::vector<std::unique_ptr<MemoryBlock>>::iterator it)
+{
+    // queued ranges must not outlive the memory they refer to
+    const VkDeviceMemory memory = (*it)->memory()->handle();
+    for (auto *ranges : { &m_pendingFlushRanges, &m_pendingInvalidateRanges }) {
+        auto end = std::remove_if(ranges->begin(), ranges->end(), [memory](const VkMappedMemoryRange &range) {
+            return range.memory == memory;
+        });
+        ranges->erase(end, ranges->end());
+    }
+
+    m_blocks[(*it)->memoryTypeIndex()].erase(it);
+}
+
+std::vector<Allocation *> Allocator::movableAllocations() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<Allocation *> allocations;
+    for (uint32_t i = 0; i < m_device->memoryProperties().memoryTypeCount; ++i) {
+        // host visible memory is left alone, its users may hold on to mapped pointers
+        if (m_device->memoryProperties().memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+            continue;
+
+        std::vector<const MemoryBlock *> blocks;
+        for (const auto &block : m_blocks[i]) {
+            if (!block->isEmpty() && !block->isDedicated())
+                blocks.push_back(block.get());
+        }
+        std::sort(blocks.begin(), blocks.end(), [](const MemoryBlock *a, const MemoryBlock *b) {
+            return a->allocatedSize() < b->allocatedSize();
+        });
+
+        for (size_t j = 0; j < blocks.size(); ++j) {
+            // the densest block is only worth touching if it has holes to close
+            if (j == blocks.size() - 1 && blocks[j]->freeRangeCount() <= 1)
+                continue;
+            // allocations at the end of a block first, so moves within the block compact it
+            for (auto it = blocks[j]->allocations().rbegin(); it != blocks[j]->allocations().rend(); ++it) {
+                if (it->second->buffer())
+                    allocations.push_back(it->second);
+            }
+        }
+    }
+    return allocations;
+}
+
+std::unique_ptr<Allocation> Allocator::relocate(const Allocation *allocation, const VkMemoryRequirements &requirements)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    MemoryBlock *sourceBlock = allocation->block();
+
+    std::vector<MemoryBlock *> blocks;
+    for (const auto &block : m_blocks[sourceBlock->memoryTypeIndex()]) {
+        if (!block->isDedicated() && block->allocatedSize() > sourceBlock->allocatedSize())
+            blocks.push_back(block.get());
+    }
+    std::sort(blocks.begin(), blocks.end(), [](const MemoryBlock *a, const MemoryBlock *b) {
+        return a->allocatedSize() > b->allocatedSize();
+    });
+
+    for (auto *block : blocks) {
+        if (auto destination = block->allocate(requirements.size, requirements.alignment))
+            return destination;
+    }
+
+    return sourceBlock->allocate(requirements.size, requirements.alignment, allocation->offset());
+}
+
+size_t Allocator::releaseEmptyBlocks()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    size_t releasedCount = 0;
+    for (auto &blocks : m_blocks) {
+        for (auto it = blocks.begin(); it != blocks.end();) {
+            if ((*it)->isEmpty()) {
+                const auto index = std::distance(blocks.begin(), it);
+                releaseBlock(it);
+                it = blocks.begin() + index;
+                ++releasedCount;
+            } else {
+                ++it;
+            }
+        }
+    }
+    return releasedCount;
+}
+
+void Allocator::queueFlush(const VkMappedMemoryRange &range)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pendingFlushRanges.push_back(range);
+}
+
+void Allocator::queueInvalidate(const VkMappedMemoryRange &range)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pendingInvalidateRanges.push_back(range);
+}
+
+void Allocator::flushMappedRanges()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_pendingFlushRanges.empty())
+        return;
+    mergeMappedRanges(m_pendingFlushRanges);
+    if (vkFlushMappedMemoryRanges(m_device->device(), static_cast<uint32_t>(m_pendingFlushRanges.size()), m_pendingFlushRanges.data()) != VK_SUCCESS)
+        throw std::runtime_error("Failed to flush mapped memory ranges");
+    m_pendingFlushRanges.clear();
+}
+
+void Allocator::invalidateMappedRanges()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_pendingInvalidateRanges.empty())
+        return;
+    mergeMappedRanges(m_pendingInvalidateRanges);
+    if (vkInvalidateMappedMemoryRanges(m_device->device(), static_cast<uint32_t>(m_pendingInvalidateRanges.size()), m_pendingInvalidateRanges.data()) != VK_SUCCESS)
+        throw std::runtime_error("Failed to invalidate mapped memory ranges");
+    m_pendingInvalidateRanges.clear();
+}
+
+MemoryStatistics Allocator::statistics() const
+{
+    const auto &memoryProperties = m_device->memoryProperties();
+
+    MemoryStatistics statistics;
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i)
+        statistics.heaps.push_back({ .size = memoryProperties.memoryHeaps[i].size, .flags = memoryProperties.memoryHeaps[i].flags });
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+        MemoryStatistics::Type type = {
+            .propertyFlags = memoryProperties.memoryTypes[i].propertyFlags,
+            .heapIndex = memoryProperties.memoryTypes[i].heapIndex
+        };
+        for (const auto &block : m_blocks[i]) {
+            MemoryStatistics::Usage usage = {
+                .blockCount = 1,
+                .dedicatedBlockCount = block->isDedicated() ? 1u : 0u,
+                .allocationCount = block->allocationCount(),
+                .blockBytes = block->size(),
+                .allocationBytes = block->allocatedSize(),
+                .freeRangeCount = block->freeRangeCount(),
+                .largestFreeRange = block->largestFreeRange()
+            };
+            type.usage.add(usage);
+        }
+        statistics.heaps[type.heapIndex].usage.add(type.usage);
+        statistics.total.add(type.usage);
+        statistics.types.push_back(type);
+    }
+
+    return statistics;
+}
+
+} // namespace V
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "vdevice.h"
+
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace V {
+
+class Allocator;
+class Buffer;
+class MemoryBlock;
+
+// Snapshot of the device memory held by an Allocator, per memory type and per heap. The
+// budget fields are only filled in when the device supports VK_EXT_memory_budget.
+struct MemoryStatistics {
+    struct Usage {
+        size_t blockCount = 0;
+        size_t dedicatedBlockCount = 0;
+        size_t allocationCount = 0;
+        VkDeviceSize blockBytes = 0; // device memory allocated from Vulkan
+        VkDeviceSize allocationBytes = 0; // bytes handed out to allocations
+        size_t freeRangeCount = 0;
+        VkDeviceSize largestFreeRange = 0;
+
+        void add(const Usage &other);
+    };
+
+    struct Type {
+        VkMemoryPropertyFlags propertyFlags;
+        uint32_t heapIndex;
+        Usage usage;
+    };
+
+    struct Heap {
+        VkDeviceSize size;
+        VkMemoryHeapFlags flags;
+        Usage usage;
+        VkDeviceSize budget = 0;
+        VkDeviceSize budgetUsage = 0; // usage of the whole process, as reported by the driver
+    };
+
+    std::vector<Type> types;
+    std::vector<Heap> heaps;
+    Usage total;
+    bool hasBudget = false;
+
+    std::string toJson() const;
+};
+
+class Allocation : private NonCopyable
+{
+public:
+    Allocation(MemoryBlock *block, VkDeviceSize offset, VkDeviceSize size);
+    ~Allocation();
+
+    MemoryBlock *block() const { return m_block; }
+    const Memory *memory() const;
+
+    VkDeviceSize offset() const { return m_offset; }
+    VkDeviceSize size() const { return m_size; }
+
+    // see Memory::flush() and Memory::invalidate(), offsets are relative to the allocation
+    void flush(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) const;
+    void invalidate(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) const;
+
+    // the buffer owning this allocation, if any; only owned allocations can be moved by the Defragmenter
+    Buffer *buffer() const { return m_buffer; }
+    void setBuffer(Buffer *buffer) { m_buffer = buffer; }
+
+    template<typename T>
+    T *map() const
+    {
+        return reinterpret_cast<T *>(mapData());
+    }
+
+private:
+    void *mapData() const;
+
+    MemoryBlock *m_block;
+    VkDeviceSize m_offset;
+    VkDeviceSize m_size;
+    Buffer *m_buffer = nullptr;
+};
+
+// A single VkDeviceMemory allocation carved into sub-allocations. Free space is kept
+// both by offset (for coalescing neighbours) and by size (for best-fit lookups).
+class MemoryBlock : private NonCopyable
+{
+public:
+    MemoryBlock(Allocator *allocator, uint32_t memoryTypeIndex, VkDeviceSize size, bool dedicated = false, VkBuffer dedicatedBuffer = VK_NULL_HANDLE);
+    ~MemoryBlock();
+
+    Allocator *allocator() const { return m_allocator; }
+    const Memory *memory() const { return m_memory.get(); }
+    uint32_t memoryTypeIndex() const { return m_memoryTypeIndex; }
+
+    // dedicated blocks hold a single allocation and are released as soon as it is freed
+    bool isDedicated() const { return m_dedicated; }
+
+    VkDeviceSize size() const;
+    bool isEmpty() const { return m_allocations.empty(); }
+    size_t allocationCount() const { return m_allocations.size(); }
+    const std::map<VkDeviceSize, Allocation *> &allocations() const { return m_allocations; }
+    VkDeviceSize allocatedSize() const { return m_allocatedSize; }
+    size_t freeRangeCount() const { return m_freeRanges.size(); }
+    VkDeviceSize largestFreeRange() const;
+
+    // only places the allocation where it ends at or before endOffset
+    std::unique_ptr<Allocation> allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize endOffset = VK_WHOLE_SIZE);
+    void free(const Allocation *allocation);
+
+private:
+    void insertFreeRange(VkDeviceSize offset, VkDeviceSize size);
+    void eraseFreeRange(VkDeviceSize offset, VkDeviceSize size);
+
+    Allocator *m_allocator;
+    uint32_t m_memoryTypeIndex;
+    bool m_dedicated;
+    std::unique_ptr<Memory> m_memory;
+    std::map<VkDeviceSize, VkDeviceSize> m_freeRanges; // offset -> size
+    std::set<std::pair<VkDeviceSize, VkDeviceSize>> m_freeRangesBySize; // (size, offset)
+    std::map<VkDeviceSize, Allocation *> m_allocations; // offset -> allocation
+    VkDeviceSize m_allocatedSize = 0;
+};
+
+class Allocator : private NonCopyable
+{
+public:
+    static constexpr VkDeviceSize DefaultBlockSize = 64 * 1024 * 1024;
+
+    explicit Allocator(const Device *device, VkDeviceSize blockSize = DefaultBlockSize);
+    ~Allocator();
+
+    const Device *device() const { return m_device; }
+
+    // requests at least this large are better off with a dedicated allocation
+    VkDeviceSize dedicatedThreshold() const { return m_blockSize / 2; }
+
+    std::unique_ptr<Allocation> allocate(const VkMemoryRequirements &requirements, uint32_t memoryTypeIndex);
+    // dedicatedBuffer is passed on to the driver through VkMemoryDedicatedAllocateInfo when not null
+    std::unique_ptr<Allocation> allocateDedicated(const VkMemoryRequirements &requirements, uint32_t memoryTypeIndex, VkBuffer dedicatedBuffer);
+    void free(const Allocation *allocation);
+
+    MemoryStatistics statistics() const;
+
+    // Defragmentation support. movableAllocations() lists buffer-owned allocations in device
+    // local memory, sparsest blocks first. relocate() finds a new place for one of them in a
+    // denser block or earlier in its own block, and returns null if moving it would not help.
+    std::vector<Allocation *> movableAllocations() const;
+    std::unique_ptr<Allocation> relocate(const Allocation *allocation, const VkMemoryRequirements &requirements);
+    size_t releaseEmptyBlocks();
+
+    // ranges of non-coherent memory queued by Memory::flush() and Memory::invalidate()
+    void queueFlush(const VkMappedMemoryRange &range);
+    void queueInvalidate(const VkMappedMemoryRange &range);
+    void flushMappedRanges();
+    void invalidateMappedRanges();
+
+private:
+    void releaseBlock(std::vector<std::unique_ptr<MemoryBlock>>::iterator it);
+
+    const Device *m_device;
+    VkDeviceSize m_blockSize;
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<MemoryBlock>> m_blocks[VK_MAX_MEMORY_TYPES];
+    std::vector<VkMappedMemoryRange> m_pendingFlushRanges;
+    std::vector<VkMappedMemoryRange> m_pendingInvalidateRanges;
+};
+
+} // namespace V
@@ -0,0 +1,119 @@
+#include "vbarrierbatch.h"
+
+#include "vbuffer.h"
+#include "vcommandbuffer.h"
+
+#include <iostream>
+#include <stdexcept>
+
+namespace V {
+
+namespace {
+
+bool isVisible(const ResourceState &state, VkPipelineStageFlags stageMask, VkAccessFlags accessMask)
+{
+    return (stageMask & ~state.visibleStages) == 0 && (accessMask & ~state.visibleAccess) == 0;
+}
+
+} // namespace
+
+BarrierBatch::BarrierBatch(bool debug)
+    : m_debug(debug)
+{
+}
+
+BarrierBatch::~BarrierBatch() = default;
+
+void BarrierBatch::access(const Buffer *buffer, VkPipelineStageFlags stageMask, VkAccessFlags accessMask)
+{
+    const bool write = (accessMask & WriteAccessMask) != 0;
+    for (const auto &transition : m_transitions) {
+        if (transition.buffer == buffer && (write || transition.write))
+            throw std::runtime_error("Buffer written more than once or both read and written in one barrier batch");
+    }
+    ++m_statistics.accesses;
+
+    auto &state = buffer->state();
+    VkPipelineStageFlags srcStageMask = 0;
+    VkAccessFlags srcAccessMask = 0;
+    if (write) {
+        // after reads only an execution dependency is needed, the last write is already available
+        const VkAccessFlags readAccessMask = accessMask & ~WriteAccessMask;
+        if (state.readStages == 0 || (readAccessMask != 0 && !isVisible(state, stageMask, readAccessMask))) {
+            srcStageMask = state.writeStages;
+            srcAccessMask = state.writeAccess;
+        }
+        srcStageMask |= state.readStages;
+        state = { stageMask, accessMask & WriteAccessMask, 0, 0, 0 };
+    } else {
+        if (state.writeStages != 0 && !isVisible(state, stageMask, accessMask)) {
+            srcStageMask = state.writeStages;
+            srcAccessMask = state.writeAccess;
+            state.visibleStages |= stageMask;
+            state.visibleAccess |= accessMask;
+        }
+        state.readStages |= stageMask;
+    }
+
+    m_transitions.push_back({ buffer, srcStageMask, stageMask, write });
+    if (srcStageMask == 0) {
+        ++m_statistics.skipped;
+        return;
+    }
+
+    m_srcStageMask |= srcStageMask;
+    m_dstStageMask |= stageMask;
+    if (srcAccessMask != 0) {
+        VkBufferMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .srcAccessMask = srcAccessMask,
+            .dstAccessMask = accessMask,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = buffer->handle(),
+            .offset = 0,
+            .size = VK_WHOLE_SIZE
+        };
+        m_bufferBarriers.push_back(barrier);
+    }
+}
+
+void BarrierBatch::flush(const CommandBuffer *commandBuffer)
+{
+    if (!isEmpty()) {
+        if (m_debug)
+            reportOverSynchronization();
+
+        commandBuffer->pipelineBarrier(m_srcStageMask, m_dstStageMask, {}, m_bufferBarriers);
+        ++m_statistics.pipelineBarriers;
+        m_statistics.bufferBarriers += m_bufferBarriers.size();
+    }
+
+    m_srcStageMask = 0;
+    m_dstStageMask = 0;
+    m_bufferBarriers.clear();
+    m_transitions.clear();
+}
+
+void BarrierBatch::reportOverSynchronization()
+{
+    // the merged barrier makes every destination stage wait for every source stage
+    bool overSynchronized = false;
+    for (VkPipelineStageFlags dstStage = 1; dstStage != 0 && dstStage <= m_dstStageMask; dstStage <<= 1) {
+        if ((m_dstStageMask & dstStage) == 0)
+            continue;
+        VkPipelineStageFlags neededStageMask = 0;
+        for (const auto &transition : m_transitions) {
+            if (transition.dstStageMask & dstStage)
+                neededStageMask |= transition.srcStageMask;
+        }
+        if (const VkPipelineStageFlags extraStageMask = m_srcStageMask & ~neededStageMask) {
+            std::cerr << std::hex << "BarrierBatch: stage 0x" << dstStage << " also waits for stages 0x" << extraStageMask << std::dec << '\n';
+            overSynchronized = true;
+        }
+    }
+    if (overSynchronized)
+        ++m_statistics.overSynchronized;
+}
+
+} // namespace V
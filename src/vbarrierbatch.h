@@ -0,0 +1,77 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace V {
+
+class Buffer;
+class CommandBuffer;
+
+// The last accesses of a resource, as declared to a BarrierBatch. Accesses are assumed to
+// execute in the order they are declared, on a single queue; other queues need a semaphore
+// and, for exclusive resources, an ownership transfer. Images would add their layout here.
+struct ResourceState {
+    VkPipelineStageFlags writeStages = 0; // 0 while nothing has written the resource
+    VkAccessFlags writeAccess = 0;
+    VkPipelineStageFlags readStages = 0; // stages that read since the last write
+    VkPipelineStageFlags visibleStages = 0; // stages and accesses the last write was made visible to
+    VkAccessFlags visibleAccess = 0;
+};
+
+// Collects the barriers needed before the next commands and records them with a single
+// vkCmdPipelineBarrier. Callers declare every access of a tracked resource with access(), then
+// flush() before recording the commands performing those accesses. Reads of data that is
+// already visible and first uses need no barrier and are skipped.
+//
+// In debug mode, flush() reports merged barriers that make a stage wait for source stages
+// none of its own transitions needed; splitting such a batch would synchronize less.
+class BarrierBatch : private NonCopyable
+{
+public:
+    static constexpr VkAccessFlags WriteAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+    struct Statistics {
+        uint64_t accesses = 0;
+        uint64_t skipped = 0; // accesses that needed no barrier
+        uint64_t bufferBarriers = 0;
+        uint64_t pipelineBarriers = 0; // vkCmdPipelineBarrier calls
+        uint64_t overSynchronized = 0; // flushes reported in debug mode
+    };
+
+    explicit BarrierBatch(bool debug = false);
+    ~BarrierBatch();
+
+    bool isDebug() const { return m_debug; }
+
+    // Accessing a buffer twice between flushes is only allowed when neither access writes.
+    void access(const Buffer *buffer, VkPipelineStageFlags stageMask, VkAccessFlags accessMask);
+
+    bool isEmpty() const { return m_srcStageMask == 0; }
+    void flush(const CommandBuffer *commandBuffer);
+
+    const Statistics &statistics() const { return m_statistics; }
+
+private:
+    struct Transition {
+        const Buffer *buffer;
+        VkPipelineStageFlags srcStageMask; // 0 if the access needed no barrier
+        VkPipelineStageFlags dstStageMask;
+        bool write;
+    };
+
+    void reportOverSynchronization();
+
+    bool m_debug;
+    VkPipelineStageFlags m_srcStageMask = 0;
+    VkPipelineStageFlags m_dstStageMask = 0;
+    std::vector<VkBufferMemoryBarrier> m_bufferBarriers;
+    std::vector<Transition> m_transitions; // every access since the last flush
+    Statistics m_statistics;
+};
+
+} // namespace V
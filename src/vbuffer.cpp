@@ -1,12 +1,17 @@
 #include "vbuffer.h"
 
+#include "vallocator.h"
+#include "vdescriptorset.h"
 #include "vmemory.h"
 
+#include <utility>
+
 namespace V {
 
 Buffer::Buffer(const Device *device, VkDeviceSize size, VkBufferUsageFlags usage)
     : m_device(device)
     , m_size(size)
+    , m_usage(usage)
 {
     uint32_t queueFamilyIndex = m_device->queueFamilyIndex();
     VkBufferCreateInfo bufferCreateInfo {
@@ -18,14 +23,24 @@ Buffer::Buffer(const Device *device, VkDeviceSize size, VkBufferUsageFlags usage
         .pQueueFamilyIndices = &queueFamilyIndex
     };
 
-    if (vkCreateBuffer(m_device->device(), &bufferCreateInfo, nullptr, &m_handle) != VK_SUCCESS)
+    if (vkCreateBuffer(m_device->device(), &bufferCreateInfo, m_device->allocationCallbacks(), &m_handle) != VK_SUCCESS)
         throw std::runtime_error("Failed to create buffer");
 }
 
+// device local buffers can be copied around by the Defragmenter
+Buffer::Buffer(const Device *device, VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memoryUsage)
+    : Buffer(device, size, memoryUsage == MemoryUsage::GpuOnly ? usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT : usage)
+{
+    bindMemory(m_device->allocateMemory(this, memoryUsage));
+}
+
 Buffer::~Buffer()
 {
+    for (const auto *descriptorSet : m_descriptorSets)
+        descriptorSet->removeBuffer(this);
+
     if (m_handle != VK_NULL_HANDLE)
-        vkDestroyBuffer(m_device->device(), m_handle, nullptr);
+        vkDestroyBuffer(m_device->device(), m_handle, m_device->allocationCallbacks());
 }
 
 void Buffer::bindMemory(const Memory *memory, VkDeviceSize offset) const
@@ -34,4 +49,39 @@ void Buffer::bindMemory(const Memory *memory, VkDeviceSize offset) const
         throw std::runtime_error("Failed to bind buffer");
 }
 
+void Buffer::bindMemory(const Allocation *allocation) const
+{
+    bindMemory(allocation->memory(), allocation->offset());
+}
+
+void Buffer::bindMemory(std::unique_ptr<Allocation> allocation)
+{
+    bindMemory(allocation.get());
+    m_allocation = std::move(allocation);
+    m_allocation->setBuffer(this);
+}
+
+void Buffer::swapStorage(Buffer *other)
+{
+    std::swap(m_handle, other->m_handle);
+    std::swap(m_allocation, other->m_allocation);
+    if (m_allocation)
+        m_allocation->setBuffer(this);
+    if (other->m_allocation)
+        other->m_allocation->setBuffer(other);
+
+    for (const auto *descriptorSet : m_descriptorSets)
+        descriptorSet->updateBuffer(this);
+}
+
+void Buffer::addDescriptorSet(const DescriptorSet *descriptorSet) const
+{
+    m_descriptorSets.insert(descriptorSet);
+}
+
+void Buffer::removeDescriptorSet(const DescriptorSet *descriptorSet) const
+{
+    m_descriptorSets.erase(descriptorSet);
+}
+
 } // namespace V
@@ -1,28 +1,76 @@
 #pragma once
 
+#include "vbarrierbatch.h"
 #include "vdevice.h"
 
+#include <set>
+
 namespace V {
 
+class Buffer;
+class DescriptorSet;
+
+// A range of a buffer. Converts implicitly from a Buffer pointer, covering the whole buffer.
+struct BufferSlice {
+    BufferSlice(const Buffer *buffer)
+        : BufferSlice(buffer, 0, VK_WHOLE_SIZE)
+    {
+    }
+
+    BufferSlice(const Buffer *buffer, VkDeviceSize offset, VkDeviceSize size)
+        : buffer(buffer)
+        , offset(offset)
+        , size(size)
+    {
+    }
+
+    const Buffer *buffer;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+};
+
 class Buffer : private NonCopyable
 {
 public:
     explicit Buffer(const Device *device, VkDeviceSize size, VkBufferUsageFlags usage);
+    explicit Buffer(const Device *device, VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memoryUsage);
     ~Buffer();
 
     const Device *device() const { return m_device; }
     VkDevice deviceHandle() const { return m_device->device(); }
 
     VkDeviceSize size() const { return m_size; }
+    VkBufferUsageFlags usage() const { return m_usage; }
 
     VkBuffer handle() const { return m_handle; }
 
+    // only set for buffers created with a MemoryUsage, which own their memory
+    const Allocation *allocation() const { return m_allocation.get(); }
+
     void bindMemory(const Memory *memory, VkDeviceSize offset) const;
+    void bindMemory(const Allocation *allocation) const;
+    void bindMemory(std::unique_ptr<Allocation> allocation); // takes ownership
+
+    // Exchanges the handle and memory with another buffer of the same size and usage, and
+    // rewrites the descriptor sets referencing this buffer. Used to move buffers around when
+    // defragmenting; the other buffer keeps the old handle alive until it is destroyed.
+    void swapStorage(Buffer *other);
+
+    // kept up to date by DescriptorSet::writeBuffer()
+    void addDescriptorSet(const DescriptorSet *descriptorSet) const;
+    void removeDescriptorSet(const DescriptorSet *descriptorSet) const;
+
+    // updated by BarrierBatch::access()
+    ResourceState &state() const { return m_state; }
 
 private:
     const Device *m_device;
     VkDeviceSize m_size;
+    VkBufferUsageFlags m_usage;
     VkBuffer m_handle;
+    std::unique_ptr<Allocation> m_allocation;
+    mutable std::set<const DescriptorSet *> m_descriptorSets;
+    mutable ResourceState m_state;
 };
 
 } // namespace V
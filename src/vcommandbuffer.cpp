@@ -7,17 +7,32 @@
 #include "vpipelinelayout.h"
 
 #include <algorithm>
+#include <cstring>
 #include <stdexcept>
 
 namespace V {
 
-CommandBuffer::CommandBuffer(const CommandPool *commandPool)
+void CommandBuffer::BindStatistics::add(const BindStatistics &other)
+{
+    const auto addCounter = [](BindCounter &counter, const BindCounter &otherCounter) {
+        counter.issued += otherCounter.issued;
+        counter.skipped += otherCounter.skipped;
+    };
+    addCounter(pipeline, other.pipeline);
+    addCounter(descriptorSets, other.descriptorSets);
+    addCounter(vertexBuffers, other.vertexBuffers);
+    addCounter(indexBuffer, other.indexBuffer);
+    addCounter(pushConstants, other.pushConstants);
+}
+
+CommandBuffer::CommandBuffer(const CommandPool *commandPool, VkCommandBufferLevel level)
     : m_commandPool(commandPool)
+    , m_level(level)
 {
     VkCommandBufferAllocateInfo commandBufferAllocateInfo {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
         .commandPool = m_commandPool->handle(),
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .level = m_level,
         .commandBufferCount = 1
     };
 
@@ -31,18 +46,42 @@ CommandBuffer::~CommandBuffer()
         vkFreeCommandBuffers(m_commandPool->deviceHandle(), m_commandPool->handle(), 1, &m_handle);
 }
 
-void CommandBuffer::begin() const
+void CommandBuffer::begin(VkCommandBufferUsageFlags flags) const
+{
+    VkCommandBufferBeginInfo commandBufferBeginInfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = flags
+    };
+
+    if (vkBeginCommandBuffer(m_handle, &commandBufferBeginInfo) != VK_SUCCESS)
+        throw std::runtime_error("Failed to begin command buffer");
+
+    resetState();
+    m_bindStatistics = {};
+}
+
+void CommandBuffer::begin(VkRenderPass renderPass, uint32_t subpass, VkFramebuffer framebuffer, VkCommandBufferUsageFlags flags) const
 {
+    VkCommandBufferInheritanceInfo commandBufferInheritanceInfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .renderPass = renderPass,
+        .subpass = subpass,
+        .framebuffer = framebuffer
+    };
     VkCommandBufferBeginInfo commandBufferBeginInfo {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT
+        .flags = flags | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .pInheritanceInfo = &commandBufferInheritanceInfo
     };
 
     if (vkBeginCommandBuffer(m_handle, &commandBufferBeginInfo) != VK_SUCCESS)
         throw std::runtime_error("Failed to begin command buffer");
+
+    resetState();
+    m_bindStatistics = {};
 }
 
-void CommandBuffer::beginRenderPass(VkRenderPass renderPass, VkFramebuffer framebuffer, VkRect2D renderArea) const
+void CommandBuffer::beginRenderPass(VkRenderPass renderPass, VkFramebuffer framebuffer, VkRect2D renderArea, VkSubpassContents contents) const
 {
     VkClearValue clearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
     VkRenderPassBeginInfo renderPassBeginInfo = {
@@ -53,28 +92,178 @@ void CommandBuffer::beginRenderPass(VkRenderPass renderPass, VkFramebuffer frame
         .clearValueCount = 1,
         .pClearValues = &clearColor
     };
-    vkCmdBeginRenderPass(m_handle, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(m_handle, &renderPassBeginInfo, contents);
 }
 
 void CommandBuffer::bindPipeline(const Pipeline *pipeline) const
 {
-    vkCmdBindPipeline(m_handle, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->handle());
+    m_lastBindPoint = pipeline->bindPoint();
+    auto &boundPipeline = m_boundPipelines[pipeline->bindPoint()];
+    if (pipeline->handle() == boundPipeline) {
+        ++m_bindStatistics.pipeline.skipped;
+        return;
+    }
+    vkCmdBindPipeline(m_handle, pipeline->bindPoint(), pipeline->handle());
+    boundPipeline = pipeline->handle();
+    ++m_bindStatistics.pipeline.issued;
+}
+
+void CommandBuffer::bindVertexBuffer(uint32_t binding, const BufferSlice &buffer) const
+{
+    if (binding >= MaxVertexBuffers)
+        throw std::runtime_error("Too many vertex buffers");
+
+    VkBuffer bufferHandle = buffer.buffer->handle();
+    if (binding < m_boundVertexBuffers.size() && m_boundVertexBuffers[binding].buffer == bufferHandle && m_boundVertexBuffers[binding].offset == buffer.offset) {
+        ++m_bindStatistics.vertexBuffers.skipped;
+        return;
+    }
+    vkCmdBindVertexBuffers(m_handle, binding, 1, &bufferHandle, &buffer.offset);
+    if (binding >= m_boundVertexBuffers.size())
+        m_boundVertexBuffers.resize(binding + 1);
+    m_boundVertexBuffers[binding] = { bufferHandle, buffer.offset };
+    ++m_bindStatistics.vertexBuffers.issued;
 }
 
-void CommandBuffer::bindVertexBuffers(const std::vector<const Buffer *> &buffers) const
+void CommandBuffer::bindVertexBuffers(Span<const BufferSlice> buffers) const
 {
-    std::vector<VkBuffer> bufferHandles(buffers.size());
-    std::transform(buffers.begin(), buffers.end(), bufferHandles.begin(), [](const Buffer *buffer) {
-        return buffer->handle();
-    });
-    std::vector<VkDeviceSize> offsets(buffers.size(), 0);
-    vkCmdBindVertexBuffers(m_handle, 0, bufferHandles.size(), bufferHandles.data(), offsets.data());
+    bindVertexBuffers(0, buffers);
 }
 
-void CommandBuffer::bindDescriptorSet(const PipelineLayout *pipelineLayout, const DescriptorSet *descriptorSet) const
+void CommandBuffer::bindVertexBuffers(uint32_t firstBinding, Span<const BufferSlice> buffers) const
 {
+    if (firstBinding + buffers.size() > MaxVertexBuffers)
+        throw std::runtime_error("Too many vertex buffers");
+
+    const auto isBound = [this, firstBinding, buffers](size_t index) {
+        const size_t binding = firstBinding + index;
+        return binding < m_boundVertexBuffers.size() && m_boundVertexBuffers[binding].buffer == buffers[index].buffer->handle() && m_boundVertexBuffers[binding].offset == buffers[index].offset;
+    };
+
+    // only rebind the range of bindings that actually changes
+    size_t first = 0;
+    while (first < buffers.size() && isBound(first))
+        ++first;
+    if (first == buffers.size()) {
+        ++m_bindStatistics.vertexBuffers.skipped;
+        return;
+    }
+    size_t last = buffers.size();
+    while (isBound(last - 1))
+        --last;
+
+    StaticVector<VkBuffer, MaxVertexBuffers> bufferHandles;
+    StaticVector<VkDeviceSize, MaxVertexBuffers> offsets;
+    for (size_t index = first; index < last; ++index) {
+        bufferHandles.push_back(buffers[index].buffer->handle());
+        offsets.push_back(buffers[index].offset);
+    }
+    vkCmdBindVertexBuffers(m_handle, firstBinding + first, bufferHandles.size(), bufferHandles.data(), offsets.data());
+
+    if (firstBinding + last > m_boundVertexBuffers.size())
+        m_boundVertexBuffers.resize(firstBinding + last);
+    for (size_t index = first; index < last; ++index)
+        m_boundVertexBuffers[firstBinding + index] = { bufferHandles[index - first], offsets[index - first] };
+    ++m_bindStatistics.vertexBuffers.issued;
+}
+
+void CommandBuffer::bindIndexBuffer(const BufferSlice &buffer, VkIndexType indexType) const
+{
+    const VkBuffer bufferHandle = buffer.buffer->handle();
+    if (m_boundIndexBuffer.buffer == bufferHandle && m_boundIndexBuffer.offset == buffer.offset && m_boundIndexType == indexType) {
+        ++m_bindStatistics.indexBuffer.skipped;
+        return;
+    }
+    vkCmdBindIndexBuffer(m_handle, bufferHandle, buffer.offset, indexType);
+    m_boundIndexBuffer = { bufferHandle, buffer.offset };
+    m_boundIndexType = indexType;
+    ++m_bindStatistics.indexBuffer.issued;
+}
+
+void CommandBuffer::bindDescriptorSet(const PipelineLayout *pipelineLayout, const DescriptorSet *descriptorSet, Span<const uint32_t> dynamicOffsets) const
+{
+    bindDescriptorSet(pipelineLayout, 0, descriptorSet, dynamicOffsets);
+}
+
+void CommandBuffer::bindDescriptorSet(const PipelineLayout *pipelineLayout, uint32_t set, const DescriptorSet *descriptorSet, Span<const uint32_t> dynamicOffsets) const
+{
+    bindDescriptorSet(m_lastBindPoint, pipelineLayout, set, descriptorSet, dynamicOffsets);
+}
+
+void CommandBuffer::bindDescriptorSet(VkPipelineBindPoint bindPoint, const PipelineLayout *pipelineLayout, uint32_t set, const DescriptorSet *descriptorSet, Span<const uint32_t> dynamicOffsets) const
+{
+    if (set >= MaxDescriptorSets || dynamicOffsets.size() > MaxDynamicOffsets)
+        throw std::runtime_error("Too many descriptor sets or dynamic offsets");
+
+    auto &boundDescriptorSets = m_boundDescriptorSets[bindPoint];
     VkDescriptorSet descriptorSetHandle = descriptorSet->handle();
-    vkCmdBindDescriptorSets(m_handle, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout->handle(), 0, 1, &descriptorSetHandle, 0, nullptr);
+    if (set < boundDescriptorSets.size()) {
+        const auto &bound = boundDescriptorSets[set];
+        if (bound.pipelineLayout == pipelineLayout->handle() && bound.descriptorSet == descriptorSetHandle && std::equal(bound.dynamicOffsets.begin(), bound.dynamicOffsets.end(), dynamicOffsets.begin(), dynamicOffsets.end())) {
+            ++m_bindStatistics.descriptorSets.skipped;
+            return;
+        }
+    }
+    vkCmdBindDescriptorSets(m_handle, bindPoint, pipelineLayout->handle(), set, 1, &descriptorSetHandle, dynamicOffsets.size(), dynamicOffsets.empty() ? nullptr : dynamicOffsets.data());
+    ++m_bindStatistics.descriptorSets.issued;
+
+    // binding with another layout may disturb the other sets, so forget them rather than
+    // working out layout compatibility
+    if (set >= boundDescriptorSets.size())
+        boundDescriptorSets.resize(set + 1);
+    for (auto &bound : boundDescriptorSets) {
+        if (bound.pipelineLayout != pipelineLayout->handle())
+            bound = {};
+    }
+    auto &bound = boundDescriptorSets[set];
+    bound.pipelineLayout = pipelineLayout->handle();
+    bound.descriptorSet = descriptorSetHandle;
+    bound.dynamicOffsets.assign(dynamicOffsets);
+}
+
+void CommandBuffer::pushConstants(const PipelineLayout *pipelineLayout, VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void *data) const
+{
+    if (offset + size > MaxPushConstantsSize || !pipelineLayout->isValidPushConstantUpdate(stageFlags, offset, size))
+        throw std::runtime_error("Push constants don't match the pipeline layout's ranges");
+
+    if (pipelineLayout->handle() != m_pushConstantLayout) {
+        m_pushConstantLayout = pipelineLayout->handle();
+        m_pushConstantStages.fill(0);
+    }
+
+    const bool unchanged = std::all_of(m_pushConstantStages.begin() + offset, m_pushConstantStages.begin() + offset + size, [stageFlags](VkShaderStageFlags stages) { return stages == stageFlags; }) && std::memcmp(m_pushConstantData.data() + offset, data, size) == 0;
+    if (unchanged) {
+        ++m_bindStatistics.pushConstants.skipped;
+        return;
+    }
+    vkCmdPushConstants(m_handle, pipelineLayout->handle(), stageFlags, offset, size, data);
+    std::memcpy(m_pushConstantData.data() + offset, data, size);
+    std::fill(m_pushConstantStages.begin() + offset, m_pushConstantStages.begin() + offset + size, stageFlags);
+    ++m_bindStatistics.pushConstants.issued;
+}
+
+void CommandBuffer::setViewport(const VkViewport &viewport) const
+{
+    vkCmdSetViewport(m_handle, 0, 1, &viewport);
+}
+
+void CommandBuffer::setScissor(const VkRect2D &scissor) const
+{
+    vkCmdSetScissor(m_handle, 0, 1, &scissor);
+}
+
+void CommandBuffer::setViewportAndScissor(const VkRect2D &area) const
+{
+    const VkViewport viewport = {
+        .x = static_cast<float>(area.offset.x),
+        .y = static_cast<float>(area.offset.y),
+        .width = static_cast<float>(area.extent.width),
+        .height = static_cast<float>(area.extent.height),
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f,
+    };
+    setViewport(viewport);
+    setScissor(area);
 }
 
 void CommandBuffer::draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) const
@@ -82,15 +271,107 @@ void CommandBuffer::draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t
     vkCmdDraw(m_handle, vertexCount, instanceCount, firstVertex, firstInstance);
 }
 
+void CommandBuffer::drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance) const
+{
+    vkCmdDrawIndexed(m_handle, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+}
+
+void CommandBuffer::drawIndirect(const BufferSlice &buffer, uint32_t drawCount, uint32_t stride) const
+{
+    drawIndirect(vkCmdDrawIndirect, buffer, drawCount, stride);
+}
+
+void CommandBuffer::drawIndexedIndirect(const BufferSlice &buffer, uint32_t drawCount, uint32_t stride) const
+{
+    drawIndirect(vkCmdDrawIndexedIndirect, buffer, drawCount, stride);
+}
+
+void CommandBuffer::drawIndirect(DrawIndirectFunction function, const BufferSlice &buffer, uint32_t drawCount, uint32_t stride) const
+{
+    const Device *device = m_commandPool->device();
+    const uint32_t maxDrawCount = device->enabledFeatures().multiDrawIndirect ? device->properties().limits.maxDrawIndirectCount : 1;
+    VkDeviceSize offset = buffer.offset;
+    while (drawCount > 0) {
+        const uint32_t count = std::min(drawCount, maxDrawCount);
+        function(m_handle, buffer.buffer->handle(), offset, count, stride);
+        offset += static_cast<VkDeviceSize>(count) * stride;
+        drawCount -= count;
+    }
+}
+
+void CommandBuffer::dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) const
+{
+    vkCmdDispatch(m_handle, groupCountX, groupCountY, groupCountZ);
+}
+
+void CommandBuffer::dispatchIndirect(const BufferSlice &buffer) const
+{
+    vkCmdDispatchIndirect(m_handle, buffer.buffer->handle(), buffer.offset);
+}
+
 void CommandBuffer::endRenderPass() const
 {
     vkCmdEndRenderPass(m_handle);
 }
 
+void CommandBuffer::executeCommands(Span<const CommandBuffer *const> commandBuffers) const
+{
+    constexpr size_t BatchSize = 64;
+    for (size_t i = 0; i < commandBuffers.size(); i += BatchSize) {
+        StaticVector<VkCommandBuffer, BatchSize> commandBufferHandles;
+        for (size_t j = i; j < std::min(i + BatchSize, commandBuffers.size()); ++j)
+            commandBufferHandles.push_back(commandBuffers[j]->handle());
+        vkCmdExecuteCommands(m_handle, commandBufferHandles.size(), commandBufferHandles.data());
+    }
+
+    // the state bound by the primary command buffer is undefined after executing secondaries
+    resetState();
+}
+
+void CommandBuffer::copyBuffer(const Buffer *srcBuffer, const Buffer *dstBuffer, Span<const VkBufferCopy> regions) const
+{
+    vkCmdCopyBuffer(m_handle, srcBuffer->handle(), dstBuffer->handle(), regions.size(), regions.data());
+}
+
+void CommandBuffer::memoryBarrier(VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask) const
+{
+    VkMemoryBarrier memoryBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = srcAccessMask,
+        .dstAccessMask = dstAccessMask
+    };
+    pipelineBarrier(srcStageMask, dstStageMask, { memoryBarrier }, {});
+}
+
+void CommandBuffer::bufferMemoryBarriers(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, Span<const VkBufferMemoryBarrier> barriers) const
+{
+    if (barriers.empty())
+        return;
+    pipelineBarrier(srcStageMask, dstStageMask, {}, barriers);
+}
+
+void CommandBuffer::pipelineBarrier(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, Span<const VkMemoryBarrier> memoryBarriers, Span<const VkBufferMemoryBarrier> bufferMemoryBarriers) const
+{
+    vkCmdPipelineBarrier(m_handle, srcStageMask, dstStageMask, 0, static_cast<uint32_t>(memoryBarriers.size()), memoryBarriers.data(), static_cast<uint32_t>(bufferMemoryBarriers.size()), bufferMemoryBarriers.data(), 0, nullptr);
+}
+
 void CommandBuffer::end() const
 {
     if (vkEndCommandBuffer(m_handle) != VK_SUCCESS)
         throw std::runtime_error("Failed to end command buffer");
 }
 
+void CommandBuffer::resetState() const
+{
+    m_boundPipelines = {};
+    m_lastBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    for (auto &boundDescriptorSets : m_boundDescriptorSets)
+        boundDescriptorSets.clear();
+    m_boundVertexBuffers.clear();
+    m_boundIndexBuffer = {};
+    m_boundIndexType = VK_INDEX_TYPE_UINT16;
+    m_pushConstantLayout = VK_NULL_HANDLE;
+    m_pushConstantStages.fill(0);
+}
+
 } // namespace V
@@ -1,10 +1,14 @@
 #pragma once
 
 #include "noncopyable.h"
+#include "vspan.h"
+#include "vstaticvector.h"
 
 #include <vulkan/vulkan.h>
 
-#include <vector>
+#include <array>
+#include <cstdint>
+#include <type_traits>
 
 namespace V {
 
@@ -13,27 +17,120 @@ class Pipeline;
 class DescriptorSet;
 class PipelineLayout;
 class Buffer;
+struct BufferSlice;
 
+// Binds are checked against a shadow copy of the state recorded so far, and binds that would
+// not change anything are dropped. The shadow state is cleared by begin() and executeCommands().
+// Recording does not allocate: arrays are passed as spans and the shadow state has fixed size.
 class CommandBuffer : private NonCopyable
 {
 public:
-    CommandBuffer(const CommandPool *commandPool);
+    static constexpr uint32_t MaxVertexBuffers = 32;
+    static constexpr uint32_t MaxDescriptorSets = 8;
+    static constexpr uint32_t MaxDynamicOffsets = 16;
+    static constexpr uint32_t MaxPushConstantsSize = 256;
+
+    struct BindCounter {
+        uint64_t issued = 0;
+        uint64_t skipped = 0;
+    };
+
+    // counts of binds recorded and elided since the last begin()
+    struct BindStatistics {
+        BindCounter pipeline;
+        BindCounter descriptorSets;
+        BindCounter vertexBuffers;
+        BindCounter indexBuffer;
+        BindCounter pushConstants;
+
+        void add(const BindStatistics &other);
+    };
+
+    CommandBuffer(const CommandPool *commandPool, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
     ~CommandBuffer();
 
     VkCommandBuffer handle() const { return m_handle; }
+    VkCommandBufferLevel level() const { return m_level; }
 
-    void begin() const;
-    void beginRenderPass(VkRenderPass renderPass, VkFramebuffer framebuffer, VkRect2D renderArea) const;
+    void begin(VkCommandBufferUsageFlags flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT) const;
+    // for secondary command buffers that are executed inside the given subpass of a render pass
+    void begin(VkRenderPass renderPass, uint32_t subpass, VkFramebuffer framebuffer, VkCommandBufferUsageFlags flags = 0) const;
+    void beginRenderPass(VkRenderPass renderPass, VkFramebuffer framebuffer, VkRect2D renderArea, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE) const;
     void bindPipeline(const Pipeline *pipeline) const;
-    void bindVertexBuffers(const std::vector<const Buffer *> &buffers) const;
-    void bindDescriptorSet(const PipelineLayout *pipelineLayout, const DescriptorSet *descriptorSet) const;
+    void bindVertexBuffer(uint32_t binding, const BufferSlice &buffer) const;
+    void bindVertexBuffers(Span<const BufferSlice> buffers) const;
+    void bindVertexBuffers(uint32_t firstBinding, Span<const BufferSlice> buffers) const;
+    void bindIndexBuffer(const BufferSlice &buffer, VkIndexType indexType) const;
+    // the bind point of the pipeline bound last, graphics before any pipeline is bound
+    void bindDescriptorSet(const PipelineLayout *pipelineLayout, const DescriptorSet *descriptorSet, Span<const uint32_t> dynamicOffsets = {}) const;
+    void bindDescriptorSet(const PipelineLayout *pipelineLayout, uint32_t set, const DescriptorSet *descriptorSet, Span<const uint32_t> dynamicOffsets = {}) const;
+    void bindDescriptorSet(VkPipelineBindPoint bindPoint, const PipelineLayout *pipelineLayout, uint32_t set, const DescriptorSet *descriptorSet, Span<const uint32_t> dynamicOffsets = {}) const;
+    // checked against the push constant ranges of the layout
+    void pushConstants(const PipelineLayout *pipelineLayout, VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void *data) const;
+    template<typename T>
+    void pushConstants(const PipelineLayout *pipelineLayout, VkShaderStageFlags stageFlags, const T &data, uint32_t offset = 0) const
+    {
+        static_assert(std::is_trivially_copyable_v<T> && sizeof(T) % 4 == 0, "push constants must be trivially copyable and a multiple of 4 bytes");
+        pushConstants(pipelineLayout, stageFlags, offset, sizeof(T), &data);
+    }
+    // for pipelines with dynamic viewport and scissor, the default of PipelineBuilder
+    void setViewport(const VkViewport &viewport) const;
+    void setScissor(const VkRect2D &scissor) const;
+    // both covering area, typically the render area of the render pass
+    void setViewportAndScissor(const VkRect2D &area) const;
     void draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) const;
+    void drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance) const;
+    // Draws with drawCount VkDrawIndirectCommand / VkDrawIndexedIndirectCommand structures read
+    // from buffer. Without the multiDrawIndirect feature this takes one call per command.
+    void drawIndirect(const BufferSlice &buffer, uint32_t drawCount, uint32_t stride = sizeof(VkDrawIndirectCommand)) const;
+    void drawIndexedIndirect(const BufferSlice &buffer, uint32_t drawCount, uint32_t stride = sizeof(VkDrawIndexedIndirectCommand)) const;
+    void dispatch(uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1) const;
+    void dispatchIndirect(const BufferSlice &buffer) const;
     void endRenderPass() const;
+    void executeCommands(Span<const CommandBuffer *const> commandBuffers) const;
+    void copyBuffer(const Buffer *srcBuffer, const Buffer *dstBuffer, Span<const VkBufferCopy> regions) const;
+    void memoryBarrier(VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask) const;
+    void bufferMemoryBarriers(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, Span<const VkBufferMemoryBarrier> barriers) const;
+    // see BarrierBatch for barriers derived from the tracked state of the resources
+    void pipelineBarrier(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, Span<const VkMemoryBarrier> memoryBarriers, Span<const VkBufferMemoryBarrier> bufferMemoryBarriers) const;
     void end() const;
 
+    const BindStatistics &bindStatistics() const { return m_bindStatistics; }
+
 private:
+    struct BoundDescriptorSet {
+        VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        StaticVector<uint32_t, MaxDynamicOffsets> dynamicOffsets;
+    };
+
+    struct BoundVertexBuffer {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+    };
+
+    void resetState() const;
+
+    // vkCmdDrawIndirect or vkCmdDrawIndexedIndirect, which have the same signature
+    using DrawIndirectFunction = PFN_vkCmdDrawIndirect;
+    void drawIndirect(DrawIndirectFunction function, const BufferSlice &buffer, uint32_t drawCount, uint32_t stride) const;
+
     const CommandPool *m_commandPool;
+    VkCommandBufferLevel m_level;
     VkCommandBuffer m_handle;
+
+    // shadow state, see resetState()
+    // graphics and compute state, indexed by VkPipelineBindPoint
+    mutable std::array<VkPipeline, 2> m_boundPipelines = {};
+    mutable VkPipelineBindPoint m_lastBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    mutable std::array<StaticVector<BoundDescriptorSet, MaxDescriptorSets>, 2> m_boundDescriptorSets; // per set index
+    mutable StaticVector<BoundVertexBuffer, MaxVertexBuffers> m_boundVertexBuffers; // per binding
+    mutable BoundVertexBuffer m_boundIndexBuffer;
+    mutable VkIndexType m_boundIndexType = VK_INDEX_TYPE_UINT16;
+    mutable VkPipelineLayout m_pushConstantLayout = VK_NULL_HANDLE;
+    mutable std::array<uint8_t, MaxPushConstantsSize> m_pushConstantData {};
+    mutable std::array<VkShaderStageFlags, MaxPushConstantsSize> m_pushConstantStages {}; // per byte, 0 while undefined
+    mutable BindStatistics m_bindStatistics;
 };
 
 } // namespace V
@@ -6,26 +6,35 @@
 
 namespace V {
 
-CommandPool::CommandPool(const Device *device)
+CommandPool::CommandPool(const Device *device, uint32_t queueFamilyIndex, VkCommandPoolCreateFlags flags)
     : m_device(device)
+    , m_queueFamilyIndex(queueFamilyIndex)
+    , m_flags(flags)
 {
     VkCommandPoolCreateInfo commandPoolCreateInfo {
         .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-        .queueFamilyIndex = m_device->queueFamilyIndex(),
+        .flags = m_flags,
+        .queueFamilyIndex = m_queueFamilyIndex,
     };
-    if (vkCreateCommandPool(m_device->device(), &commandPoolCreateInfo, nullptr, &m_handle) != VK_SUCCESS)
+    if (vkCreateCommandPool(m_device->device(), &commandPoolCreateInfo, m_device->allocationCallbacks(), &m_handle) != VK_SUCCESS)
         throw std::runtime_error("Failed to create command pool");
 }
 
 CommandPool::~CommandPool()
 {
     if (m_handle != VK_NULL_HANDLE)
-        vkDestroyCommandPool(m_device->device(), m_handle, nullptr);
+        vkDestroyCommandPool(m_device->device(), m_handle, m_device->allocationCallbacks());
 }
 
-std::unique_ptr<CommandBuffer> CommandPool::allocateCommandBuffer() const
+std::unique_ptr<CommandBuffer> CommandPool::allocateCommandBuffer(VkCommandBufferLevel level) const
 {
-    return std::make_unique<CommandBuffer>(this);
+    return std::make_unique<CommandBuffer>(this, level);
+}
+
+void CommandPool::reset() const
+{
+    if (vkResetCommandPool(m_device->device(), m_handle, 0) != VK_SUCCESS)
+        throw std::runtime_error("Failed to reset command pool");
 }
 
 } // namespace V
@@ -9,18 +9,25 @@ class CommandBuffer;
 class CommandPool : private NonCopyable
 {
 public:
-    explicit CommandPool(const Device *device);
+    explicit CommandPool(const Device *device, uint32_t queueFamilyIndex, VkCommandPoolCreateFlags flags = 0);
     ~CommandPool();
 
     const Device *device() const { return m_device; }
     VkDevice deviceHandle() const { return m_device->device(); }
 
     VkCommandPool handle() const { return m_handle; }
+    uint32_t queueFamilyIndex() const { return m_queueFamilyIndex; }
+    VkCommandPoolCreateFlags flags() const { return m_flags; }
 
-    std::unique_ptr<CommandBuffer> allocateCommandBuffer() const;
+    std::unique_ptr<CommandBuffer> allocateCommandBuffer(VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY) const;
+
+    // returns all command buffers allocated from the pool to the initial state
+    void reset() const;
 
 private:
     const Device *m_device;
+    uint32_t m_queueFamilyIndex;
+    VkCommandPoolCreateFlags m_flags;
     VkCommandPool m_handle;
 };
 
@@ -0,0 +1,115 @@
+#include "vdefragmenter.h"
+
+#include "vallocator.h"
+#include "vbuffer.h"
+#include "vcommandbuffer.h"
+#include "vcommandpool.h"
+#include "vfence.h"
+
+#include <stdexcept>
+
+namespace V {
+
+Defragmenter::Defragmenter(const Device *device, VkDeviceSize bytesPerSubmit)
+    : m_device(device)
+    , m_bytesPerSubmit(bytesPerSubmit)
+    , m_commandPool(device->createCommandPool())
+{
+}
+
+Defragmenter::~Defragmenter()
+{
+    // the moves in flight are completed, so that no buffer is left pointing at memory being released
+    if (m_batch.fence) {
+        m_batch.fence->wait();
+        m_movedBufferCount += completeBatch();
+    }
+}
+
+size_t Defragmenter::step(std::chrono::microseconds timeBudget)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeBudget;
+
+    size_t movedCount = 0;
+    if (m_batch.fence) {
+        if (!m_batch.fence->isSignaled())
+            return 0;
+        movedCount = completeBatch();
+    }
+
+    m_movedBufferCount += movedCount;
+    m_releasedBlockCount += m_device->allocator()->releaseEmptyBlocks();
+
+    submitBatch(deadline);
+    return movedCount;
+}
+
+size_t Defragmenter::completeBatch()
+{
+    // the old handle and allocation end up in newBuffer and are released with it
+    for (auto &move : m_batch.moves)
+        move.buffer->swapStorage(move.newBuffer.get());
+
+    const size_t movedCount = m_batch.moves.size();
+    m_batch = {};
+    return movedCount;
+}
+
+void Defragmenter::submitBatch(std::chrono::steady_clock::time_point deadline)
+{
+    auto *allocator = m_device->allocator();
+
+    std::vector<Move> moves;
+    VkDeviceSize movedBytes = 0;
+    for (auto *allocation : allocator->movableAllocations()) {
+        // at least one move per batch, so that every step makes progress
+        if (movedBytes >= m_bytesPerSubmit || (!moves.empty() && std::chrono::steady_clock::now() >= deadline))
+            break;
+
+        // a buffer with the same size and usage has the same requirements, so the new buffer
+        // is only created once there is a better place for it
+        Buffer *buffer = allocation->buffer();
+        auto newAllocation = allocator->relocate(allocation, m_device->bufferMemoryRequirements(buffer));
+        if (!newAllocation)
+            continue;
+        auto newBuffer = std::make_unique<Buffer>(m_device, buffer->size(), buffer->usage());
+        newBuffer->bindMemory(std::move(newAllocation));
+
+        movedBytes += buffer->size();
+        moves.push_back({ buffer, std::move(newBuffer) });
+    }
+    m_finished = moves.empty();
+    if (moves.empty())
+        return;
+
+    auto commandBuffer = m_commandPool->allocateCommandBuffer();
+    commandBuffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    commandBuffer->memoryBarrier(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    for (const auto &move : moves) {
+        VkBufferCopy region = {
+            .srcOffset = 0,
+            .dstOffset = 0,
+            .size = move.buffer->size()
+        };
+        commandBuffer->copyBuffer(move.buffer, move.newBuffer.get(), { region });
+    }
+    commandBuffer->memoryBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT);
+    commandBuffer->end();
+
+    auto fence = m_device->createFence();
+
+    const VkCommandBuffer commandBufferHandle = commandBuffer->handle();
+    VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &commandBufferHandle
+    };
+    if (vkQueueSubmit(m_device->queue(), 1, &submitInfo, fence->handle()) != VK_SUCCESS)
+        throw std::runtime_error("Failed to submit defragmentation command");
+
+    m_batch.commandBuffer = std::move(commandBuffer);
+    m_batch.fence = std::move(fence);
+    m_batch.moves = std::move(moves);
+}
+
+} // namespace V
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "vdevice.h"
+
+#include <chrono>
+#include <vector>
+
+namespace V {
+
+class CommandBuffer;
+
+// Compacts device local memory by moving buffers that own their allocation out of sparsely
+// used blocks (or towards the start of their block) with GPU copies, and releases the blocks
+// that end up empty. Work is split into small submits so it can be spread over several frames:
+// step() never waits for the GPU, it submits a batch of copies and the next step() after they
+// have completed switches the buffers over to their new memory.
+//
+// Moved buffers get a new handle: descriptor sets written with them are patched, but command
+// buffers recorded earlier must be re-recorded. Call step() at a point where no submitted work
+// still uses the buffers, such as right after waiting on the frame fences, and do not write to
+// the buffers between the steps that submit and complete a batch.
+class Defragmenter : private NonCopyable
+{
+public:
+    static constexpr VkDeviceSize DefaultBytesPerSubmit = 16 * 1024 * 1024;
+
+    explicit Defragmenter(const Device *device, VkDeviceSize bytesPerSubmit = DefaultBytesPerSubmit);
+    ~Defragmenter();
+
+    // Completes the batch in flight if its copies have finished and, if no batch is in flight,
+    // submits the next one with as many moves as fit in the time budget. Returns the number of
+    // buffers whose move was completed.
+    size_t step(std::chrono::microseconds timeBudget);
+
+    // nothing in flight and the last step() found nothing worth moving
+    bool isFinished() const { return m_finished && !m_batch.fence; }
+
+    size_t movedBufferCount() const { return m_movedBufferCount; }
+    size_t releasedBlockCount() const { return m_releasedBlockCount; }
+
+private:
+    struct Move {
+        Buffer *buffer;
+        std::unique_ptr<Buffer> newBuffer;
+    };
+
+    struct Batch {
+        std::unique_ptr<CommandBuffer> commandBuffer;
+        std::unique_ptr<Fence> fence;
+        std::vector<Move> moves;
+    };
+
+    size_t completeBatch();
+    void submitBatch(std::chrono::steady_clock::time_point deadline);
+
+    const Device *m_device;
+    VkDeviceSize m_bytesPerSubmit;
+    std::unique_ptr<CommandPool> m_commandPool;
+    Batch m_batch; // in flight while it has a fence
+    bool m_finished = false;
+    size_t m_movedBufferCount = 0;
+    size_t m_releasedBlockCount = 0;
+};
+
+} // namespace V
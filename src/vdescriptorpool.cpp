@@ -19,12 +19,18 @@ DescriptorPoolBuilder &DescriptorPoolBuilder::add(VkDescriptorType type, uint32_
     return *this;
 }
 
+DescriptorPoolBuilder &DescriptorPoolBuilder::setMaxSets(uint32_t maxSets)
+{
+    m_maxSets = maxSets;
+    return *this;
+}
+
 std::unique_ptr<DescriptorPool> DescriptorPoolBuilder::create() const
 {
 
     VkDescriptorPoolCreateInfo createInfo = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-        .maxSets = 1,
+        .maxSets = m_maxSets,
         .poolSizeCount = static_cast<uint32_t>(m_poolSizes.size()),
         .pPoolSizes = m_poolSizes.empty() ? nullptr : m_poolSizes.data()
     };
@@ -35,14 +41,14 @@ std::unique_ptr<DescriptorPool> DescriptorPoolBuilder::create() const
 DescriptorPool::DescriptorPool(const Device *device, const VkDescriptorPoolCreateInfo &createInfo)
     : m_device(device)
 {
-    if (vkCreateDescriptorPool(m_device->device(), &createInfo, nullptr, &m_handle) != VK_SUCCESS)
+    if (vkCreateDescriptorPool(m_device->device(), &createInfo, m_device->allocationCallbacks(), &m_handle) != VK_SUCCESS)
         throw std::runtime_error("Failed to create descriptor pool");
 }
 
 DescriptorPool::~DescriptorPool()
 {
     if (m_handle != VK_NULL_HANDLE)
-        vkDestroyDescriptorPool(m_device->device(), m_handle, nullptr);
+        vkDestroyDescriptorPool(m_device->device(), m_handle, m_device->allocationCallbacks());
 }
 
 std::unique_ptr<DescriptorSet> DescriptorPool::allocateDescriptorSet(const DescriptorSetLayout *descriptorSetLayout) const
@@ -1,8 +1,7 @@
 #pragma once
 
 #include "vdevice.h"
-
-#include <vector>
+#include "vstaticvector.h"
 
 namespace V {
 
@@ -16,12 +15,14 @@ public:
     explicit DescriptorPoolBuilder(const Device *device);
 
     DescriptorPoolBuilder &add(VkDescriptorType type, uint32_t count);
+    DescriptorPoolBuilder &setMaxSets(uint32_t maxSets);
 
     std::unique_ptr<DescriptorPool> create() const;
 
 private:
     const Device *m_device;
-    std::vector<VkDescriptorPoolSize> m_poolSizes;
+    StaticVector<VkDescriptorPoolSize, 16> m_poolSizes;
+    uint32_t m_maxSets = 1;
 };
 
 class DescriptorPool : private NonCopyable
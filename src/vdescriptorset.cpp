@@ -4,10 +4,14 @@
 #include "vdescriptorpool.h"
 #include "vdescriptorsetlayout.h"
 
+#include <algorithm>
+#include <vector>
+
 namespace V {
 
 DescriptorSet::DescriptorSet(const DescriptorPool *descriptorPool, const DescriptorSetLayout *descriptorSetLayout)
     : m_descriptorPool(descriptorPool)
+    , m_descriptorSetLayout(descriptorSetLayout)
 {
     VkDescriptorSetLayout descriptorSetLayoutHandle = descriptorSetLayout->handle();
     VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {
@@ -21,14 +25,30 @@ DescriptorSet::DescriptorSet(const DescriptorPool *descriptorPool, const Descrip
         throw std::runtime_error("Failed to allocate descriptor sets");
 }
 
-DescriptorSet::~DescriptorSet() = default; // descriptor set is automatically freed by the pool
+// descriptor set is automatically freed by the pool
+DescriptorSet::~DescriptorSet()
+{
+    for (const auto &[binding, slice] : m_bufferBindings)
+        slice.buffer->removeDescriptorSet(this);
+}
 
-void DescriptorSet::writeBuffer(uint32_t binding, const Buffer *buffer) const
+void DescriptorSet::writeBuffer(uint32_t binding, const BufferSlice &buffer) const
 {
+    // remember what is bound where, so the set can be patched if the buffer moves
+    auto it = m_bufferBindings.find(binding);
+    if (it != m_bufferBindings.end()) {
+        const Buffer *previousBuffer = it->second.buffer;
+        m_bufferBindings.erase(it);
+        if (!referencesBuffer(previousBuffer))
+            previousBuffer->removeDescriptorSet(this);
+    }
+    m_bufferBindings.emplace(binding, buffer);
+    buffer.buffer->addDescriptorSet(this);
+
     VkDescriptorBufferInfo bufferInfo = {
-        .buffer = buffer->handle(),
-        .offset = 0,
-        .range = VK_WHOLE_SIZE
+        .buffer = buffer.buffer->handle(),
+        .offset = buffer.offset,
+        .range = buffer.size
     };
 
     VkWriteDescriptorSet writeDescriptorSet = {
@@ -36,11 +56,57 @@ void DescriptorSet::writeBuffer(uint32_t binding, const Buffer *buffer) const
         .dstSet = m_handle,
         .dstBinding = binding,
         .descriptorCount = 1,
-        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorType = m_descriptorSetLayout->descriptorType(binding),
         .pBufferInfo = &bufferInfo
     };
 
     vkUpdateDescriptorSets(m_descriptorPool->deviceHandle(), 1, &writeDescriptorSet, 0, nullptr);
 }
 
+void DescriptorSet::updateBuffer(const Buffer *buffer) const
+{
+    std::vector<VkDescriptorBufferInfo> bufferInfos;
+    std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+    for (const auto &[binding, slice] : m_bufferBindings) {
+        if (slice.buffer != buffer)
+            continue;
+        VkDescriptorBufferInfo bufferInfo = {
+            .buffer = buffer->handle(),
+            .offset = slice.offset,
+            .range = slice.size
+        };
+        bufferInfos.push_back(bufferInfo);
+        VkWriteDescriptorSet writeDescriptorSet = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = m_handle,
+            .dstBinding = binding,
+            .descriptorCount = 1,
+            .descriptorType = m_descriptorSetLayout->descriptorType(binding)
+        };
+        writeDescriptorSets.push_back(writeDescriptorSet);
+    }
+    for (size_t i = 0; i < writeDescriptorSets.size(); ++i)
+        writeDescriptorSets[i].pBufferInfo = &bufferInfos[i];
+
+    if (!writeDescriptorSets.empty())
+        vkUpdateDescriptorSets(m_descriptorPool->deviceHandle(), static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+}
+
+void DescriptorSet::removeBuffer(const Buffer *buffer) const
+{
+    for (auto it = m_bufferBindings.begin(); it != m_bufferBindings.end();) {
+        if (it->second.buffer == buffer)
+            it = m_bufferBindings.erase(it);
+        else
+            ++it;
+    }
+}
+
+bool DescriptorSet::referencesBuffer(const Buffer *buffer) const
+{
+    return std::any_of(m_bufferBindings.begin(), m_bufferBindings.end(), [buffer](const auto &binding) {
+        return binding.second.buffer == buffer;
+    });
+}
+
 } // namespace V
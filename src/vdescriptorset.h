@@ -1,14 +1,16 @@
 #pragma once
 
 #include "noncopyable.h"
+#include "vbuffer.h"
 
 #include <vulkan/vulkan.h>
 
+#include <map>
+
 namespace V {
 
 class DescriptorPool;
 class DescriptorSetLayout;
-class Buffer;
 
 class DescriptorSet : private NonCopyable
 {
@@ -18,11 +20,20 @@ public:
 
     VkDescriptorSet handle() const { return m_handle; }
 
-    void writeBuffer(uint32_t binding, const Buffer *buffer) const;
+    // the descriptor type (uniform, storage, dynamic or not) is taken from the set layout
+    void writeBuffer(uint32_t binding, const BufferSlice &buffer) const;
+
+    // called by Buffer when its handle changes or it is destroyed
+    void updateBuffer(const Buffer *buffer) const;
+    void removeBuffer(const Buffer *buffer) const;
 
 private:
+    bool referencesBuffer(const Buffer *buffer) const;
+
     const DescriptorPool *m_descriptorPool;
+    const DescriptorSetLayout *m_descriptorSetLayout;
     VkDescriptorSet m_handle;
+    mutable std::map<uint32_t, BufferSlice> m_bufferBindings;
 };
 
 } // namespace V
@@ -1,5 +1,8 @@
 #include "vdescriptorsetlayout.h"
 
+#include <algorithm>
+#include <string>
+
 namespace V {
 
 DescriptorSetLayoutBuilder::DescriptorSetLayoutBuilder(const Device *device)
@@ -31,15 +34,26 @@ std::unique_ptr<DescriptorSetLayout> DescriptorSetLayoutBuilder::create() const
 
 DescriptorSetLayout::DescriptorSetLayout(const Device *device, const VkDescriptorSetLayoutCreateInfo &createInfo)
     : m_device(device)
+    , m_layoutBindings(createInfo.pBindings, createInfo.pBindings + createInfo.bindingCount)
 {
-    if (vkCreateDescriptorSetLayout(m_device->device(), &createInfo, nullptr, &m_handle) != VK_SUCCESS)
+    if (vkCreateDescriptorSetLayout(m_device->device(), &createInfo, m_device->allocationCallbacks(), &m_handle) != VK_SUCCESS)
         throw std::runtime_error("Failed to create descriptor set layout");
 }
 
 DescriptorSetLayout::~DescriptorSetLayout()
 {
     if (m_handle != VK_NULL_HANDLE)
-        vkDestroyDescriptorSetLayout(m_device->device(), m_handle, nullptr);
+        vkDestroyDescriptorSetLayout(m_device->device(), m_handle, m_device->allocationCallbacks());
+}
+
+VkDescriptorType DescriptorSetLayout::descriptorType(uint32_t binding) const
+{
+    auto it = std::find_if(m_layoutBindings.begin(), m_layoutBindings.end(), [binding](const VkDescriptorSetLayoutBinding &layoutBinding) {
+        return layoutBinding.binding == binding;
+    });
+    if (it == m_layoutBindings.end())
+        throw std::runtime_error("Descriptor set layout has no binding " + std::to_string(binding));
+    return it->descriptorType;
 }
 
 } // namespace V
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "vdevice.h"
+#include "vstaticvector.h"
 
 #include <vector>
 
@@ -19,7 +20,7 @@ public:
 
 private:
     const Device *m_device;
-    std::vector<VkDescriptorSetLayoutBinding> m_layoutBindings;
+    StaticVector<VkDescriptorSetLayoutBinding, 32> m_layoutBindings;
 };
 
 class DescriptorSetLayout : private NonCopyable
@@ -33,9 +34,12 @@ public:
 
     VkDescriptorSetLayout handle() const { return m_handle; }
 
+    VkDescriptorType descriptorType(uint32_t binding) const;
+
 private:
     const Device *m_device;
     VkDescriptorSetLayout m_handle = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSetLayoutBinding> m_layoutBindings;
 };
 
 } // namespace V
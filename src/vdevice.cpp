@@ -1,12 +1,15 @@
 #include "vdevice.h"
 
+#include "vallocator.h"
 #include "vbuffer.h"
 #include "vcommandpool.h"
 #include "vdescriptorpool.h"
 #include "vdescriptorsetlayout.h"
 #include "vfence.h"
+#include "vhostallocator.h"
 #include "vmemory.h"
 #include "vpipeline.h"
+#include "vpipelinecache.h"
 #include "vpipelinelayout.h"
 #include "vsemaphore.h"
 #include "vshadermodule.h"
@@ -15,18 +18,54 @@
 #include <GLFW/glfw3.h>
 
 #include <algorithm>
+#include <bitset>
+#include <cstring>
+#include <limits>
 #include <stdexcept>
+#include <tuple>
 #include <vector>
 
 namespace V {
 
 namespace {
 
+bool isInstanceExtensionSupported(const char *extensionName)
+{
+    uint32_t extensionCount = 0;
+    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
+
+    return std::any_of(extensions.begin(), extensions.end(), [extensionName](const VkExtensionProperties &extension) {
+        return std::strcmp(extension.extensionName, extensionName) == 0;
+    });
+}
+
+bool isDeviceExtensionSupported(VkPhysicalDevice physicalDevice, const char *extensionName)
+{
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+
+    return std::any_of(extensions.begin(), extensions.end(), [extensionName](const VkExtensionProperties &extension) {
+        return std::strcmp(extension.extensionName, extensionName) == 0;
+    });
+}
+
 std::vector<const char *> instanceExtensions()
 {
     uint32_t extensionCount = 0;
     const char **extensionNames = glfwGetRequiredInstanceExtensions(&extensionCount);
-    return std::vector<const char *>(extensionNames, extensionNames + extensionCount);
+    std::vector<const char *> extensions(extensionNames, extensionNames + extensionCount);
+
+    // needed to query VK_EXT_memory_budget on a Vulkan 1.0 instance
+    if (isInstanceExtensionSupported(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
+        extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+
+    return extensions;
 }
 
 std::vector<const char *> instanceLayers()
@@ -42,9 +81,16 @@ std::vector<const char *> deviceExtensions()
 } // namespace
 
 Device::Device()
+    : Device(std::make_unique<HostAllocator>())
+{
+}
+
+Device::Device(std::unique_ptr<HostAllocator> hostAllocator, const char *pipelineCachePath)
+    : m_hostAllocator(std::move(hostAllocator))
 {
     createInstance();
     createDeviceAndQueue();
+    m_pipelineCache = std::make_unique<PipelineCache>(this, pipelineCachePath);
 }
 
 Device::~Device()
@@ -52,6 +98,17 @@ Device::~Device()
     cleanup();
 }
 
+const VkAllocationCallbacks *Device::allocationCallbacks() const
+{
+    return m_hostAllocator ? m_hostAllocator->callbacks() : nullptr;
+}
+
+void Device::waitIdle() const
+{
+    if (vkDeviceWaitIdle(m_device) != VK_SUCCESS)
+        throw std::runtime_error("Failed to wait for device idle");
+}
+
 void Device::createInstance()
 {
     VkApplicationInfo applicationInfo {
@@ -75,8 +132,11 @@ void Device::createInstance()
         .ppEnabledExtensionNames = extensions.empty() ? nullptr : extensions.data()
     };
 
-    if (vkCreateInstance(&instanceCreateInfo, nullptr, &m_instance) != VK_SUCCESS)
+    if (vkCreateInstance(&instanceCreateInfo, allocationCallbacks(), &m_instance) != VK_SUCCESS)
         throw std::runtime_error("Failed to create instance");
+
+    if (isInstanceExtensionSupported(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
+        m_vkGetPhysicalDeviceMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(vkGetInstanceProcAddr(m_instance, "vkGetPhysicalDeviceMemoryProperties2KHR"));
 }
 
 void Device::createDeviceAndQueue()
@@ -110,38 +170,105 @@ void Device::createDeviceAndQueue()
     if (m_physicalDevice == VK_NULL_HANDLE)
         throw std::runtime_error("Could not find a physical device with a graphics queue");
 
-    float queuePriority = 1.0f;
+    // use a transfer-only queue family for uploads if there is one, so they can overlap rendering
 
-    VkDeviceQueueCreateInfo deviceQueueCreateInfo = {
-        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-        .queueFamilyIndex = m_queueFamilyIndex,
-        .queueCount = 1,
-        .pQueuePriorities = &queuePriority
-    };
+    m_transferQueueFamilyIndex = [this] {
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, nullptr);
+
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+        auto it = std::find_if(queueFamilies.begin(), queueFamilies.end(), [](const VkQueueFamilyProperties &queueFamily) {
+            return (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+        });
+        return it != queueFamilies.end() ? static_cast<uint32_t>(std::distance(queueFamilies.begin(), it)) : m_queueFamilyIndex;
+    }();
+
+    // and an async compute queue family, for compute work that overlaps rendering
+
+    m_computeQueueFamilyIndex = [this] {
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, nullptr);
+
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+        auto it = std::find_if(queueFamilies.begin(), queueFamilies.end(), [](const VkQueueFamilyProperties &queueFamily) {
+            return (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+        });
+        return it != queueFamilies.end() ? static_cast<uint32_t>(std::distance(queueFamilies.begin(), it)) : m_queueFamilyIndex;
+    }();
+
+    float queuePriority = 1.0f;
 
-    const auto extensions = deviceExtensions();
+    std::vector<VkDeviceQueueCreateInfo> deviceQueueCreateInfos;
+    for (uint32_t queueFamilyIndex : { m_queueFamilyIndex, m_transferQueueFamilyIndex, m_computeQueueFamilyIndex }) {
+        auto it = std::find_if(deviceQueueCreateInfos.begin(), deviceQueueCreateInfos.end(), [queueFamilyIndex](const VkDeviceQueueCreateInfo &createInfo) {
+            return createInfo.queueFamilyIndex == queueFamilyIndex;
+        });
+        if (it != deviceQueueCreateInfos.end())
+            continue;
+        VkDeviceQueueCreateInfo deviceQueueCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .queueFamilyIndex = queueFamilyIndex,
+            .queueCount = 1,
+            .pQueuePriorities = &queuePriority
+        };
+        deviceQueueCreateInfos.push_back(deviceQueueCreateInfo);
+    }
+
+    auto extensions = deviceExtensions();
+
+    m_hasMemoryBudget = m_vkGetPhysicalDeviceMemoryProperties2 && isDeviceExtensionSupported(m_physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (m_hasMemoryBudget)
+        extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    m_hasDedicatedAllocation = isDeviceExtensionSupported(m_physicalDevice, VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME) && isDeviceExtensionSupported(m_physicalDevice, VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME);
+    if (m_hasDedicatedAllocation) {
+        extensions.push_back(VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME);
+        extensions.push_back(VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME);
+    }
+
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(m_physicalDevice, &supportedFeatures);
+    m_enabledFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    m_enabledFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
 
     VkDeviceCreateInfo deviceCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-        .queueCreateInfoCount = 1,
-        .pQueueCreateInfos = &deviceQueueCreateInfo,
+        .queueCreateInfoCount = static_cast<uint32_t>(deviceQueueCreateInfos.size()),
+        .pQueueCreateInfos = deviceQueueCreateInfos.data(),
         .enabledExtensionCount = static_cast<uint32_t>(extensions.size()),
-        .ppEnabledExtensionNames = extensions.empty() ? nullptr : extensions.data()
+        .ppEnabledExtensionNames = extensions.empty() ? nullptr : extensions.data(),
+        .pEnabledFeatures = &m_enabledFeatures
     };
 
-    if (vkCreateDevice(m_physicalDevice, &deviceCreateInfo, nullptr, &m_device) != VK_SUCCESS)
+    if (vkCreateDevice(m_physicalDevice, &deviceCreateInfo, allocationCallbacks(), &m_device) != VK_SUCCESS)
         throw std::runtime_error("Failed to create device");
 
     vkGetDeviceQueue(m_device, m_queueFamilyIndex, 0, &m_queue);
+    vkGetDeviceQueue(m_device, m_transferQueueFamilyIndex, 0, &m_transferQueue);
+    vkGetDeviceQueue(m_device, m_computeQueueFamilyIndex, 0, &m_computeQueue);
+
+    if (m_hasDedicatedAllocation)
+        m_vkGetBufferMemoryRequirements2 = reinterpret_cast<PFN_vkGetBufferMemoryRequirements2KHR>(vkGetDeviceProcAddr(m_device, "vkGetBufferMemoryRequirements2KHR"));
+
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &m_properties);
+    vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &m_memoryProperties);
+    m_allocator = std::make_unique<Allocator>(this);
 }
 
 void Device::cleanup()
 {
+    m_pipelineCache.reset();
+    m_allocator.reset();
+
     if (m_device != VK_NULL_HANDLE)
-        vkDestroyDevice(m_device, nullptr);
+        vkDestroyDevice(m_device, allocationCallbacks());
 
     if (m_instance != VK_NULL_HANDLE)
-        vkDestroyInstance(m_instance, nullptr);
+        vkDestroyInstance(m_instance, allocationCallbacks());
 }
 
 std::unique_ptr<Surface> Device::createSurface(GLFWwindow *window) const
@@ -161,7 +288,12 @@ std::unique_ptr<Fence> Device::createFence(bool createSignaled) const
 
 std::unique_ptr<CommandPool> Device::createCommandPool() const
 {
-    return std::make_unique<CommandPool>(this);
+    return createCommandPool(m_queueFamilyIndex);
+}
+
+std::unique_ptr<CommandPool> Device::createCommandPool(uint32_t queueFamilyIndex, VkCommandPoolCreateFlags flags) const
+{
+    return std::make_unique<CommandPool>(this, queueFamilyIndex, flags);
 }
 
 std::unique_ptr<ShaderModule> Device::createShaderModule(const char *spvFilePath) const
@@ -169,6 +301,11 @@ std::unique_ptr<ShaderModule> Device::createShaderModule(const char *spvFilePath
     return std::make_unique<ShaderModule>(this, spvFilePath);
 }
 
+std::unique_ptr<ShaderModule> Device::createShaderModule(Span<const uint32_t> code) const
+{
+    return std::make_unique<ShaderModule>(this, code);
+}
+
 PipelineLayoutBuilder Device::pipelineLayoutBuilder() const
 {
     return PipelineLayoutBuilder(this);
@@ -179,29 +316,116 @@ PipelineBuilder Device::pipelineBuilder() const
     return PipelineBuilder(this);
 }
 
-std::unique_ptr<Memory> Device::allocateMemory(VkDeviceSize size) const
+ComputePipelineBuilder Device::computePipelineBuilder() const
 {
-    const int memoryTypeIndex = [this, size]() -> int {
-        VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties;
-        vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &physicalDeviceMemoryProperties);
-        constexpr uint32_t WantedProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-        for (uint32_t i = 0; i < physicalDeviceMemoryProperties.memoryTypeCount; ++i) {
-            const VkMemoryType &memoryType = physicalDeviceMemoryProperties.memoryTypes[i];
-            const VkMemoryHeap &memoryHeap = physicalDeviceMemoryProperties.memoryHeaps[memoryType.heapIndex];
-            if ((memoryType.propertyFlags & WantedProperties) == WantedProperties && memoryHeap.size >= size)
-                return i;
+    return ComputePipelineBuilder(this);
+}
+
+uint32_t Device::findMemoryType(uint32_t memoryTypeBits, MemoryUsage usage) const
+{
+    // memory types that lack a required flag are skipped; among the others the one missing the
+    // fewest preferred flags and having the fewest unwanted flags wins
+    const auto [requiredFlags, preferredFlags, unwantedFlags] = [usage]() -> std::tuple<VkMemoryPropertyFlags, VkMemoryPropertyFlags, VkMemoryPropertyFlags> {
+        switch (usage) {
+        case MemoryUsage::GpuOnly:
+            return { 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT };
+        case MemoryUsage::Upload:
+            return { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT };
+        case MemoryUsage::Readback:
+            return { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT, 0 };
+        case MemoryUsage::Dynamic:
+            return { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0 };
         }
-        return -1;
+        return { 0, 0, 0 };
     }();
+
+    int memoryTypeIndex = -1;
+    int bestCost = std::numeric_limits<int>::max();
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; ++i) {
+        if (!(memoryTypeBits & (1u << i)))
+            continue;
+        const VkMemoryPropertyFlags propertyFlags = m_memoryProperties.memoryTypes[i].propertyFlags;
+        if ((propertyFlags & requiredFlags) != requiredFlags)
+            continue;
+        const int cost = static_cast<int>(std::bitset<32>(preferredFlags & ~propertyFlags).count() + std::bitset<32>(unwantedFlags & propertyFlags).count());
+        if (cost < bestCost) {
+            memoryTypeIndex = i;
+            bestCost = cost;
+        }
+    }
     if (memoryTypeIndex == -1)
         throw std::runtime_error("Failed to find memory type");
 
-    VkMemoryAllocateInfo memoryAllocateInfo {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = size,
-        .memoryTypeIndex = static_cast<uint32_t>(memoryTypeIndex)
-    };
-    return std::make_unique<Memory>(this, memoryAllocateInfo);
+    return memoryTypeIndex;
+}
+
+std::unique_ptr<Allocation> Device::allocateMemory(const VkMemoryRequirements &requirements, MemoryUsage usage) const
+{
+    return m_allocator->allocate(requirements, findMemoryType(requirements.memoryTypeBits, usage));
+}
+
+std::unique_ptr<Allocation> Device::allocateMemory(const Buffer *buffer, MemoryUsage usage) const
+{
+    VkMemoryRequirements requirements;
+    bool dedicated = false;
+    if (m_vkGetBufferMemoryRequirements2) {
+        VkMemoryDedicatedRequirementsKHR dedicatedRequirements = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS_KHR
+        };
+        VkMemoryRequirements2KHR memoryRequirements = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2_KHR,
+            .pNext = &dedicatedRequirements
+        };
+        VkBufferMemoryRequirementsInfo2KHR bufferMemoryRequirementsInfo = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2_KHR,
+            .buffer = buffer->handle()
+        };
+        m_vkGetBufferMemoryRequirements2(m_device, &bufferMemoryRequirementsInfo, &memoryRequirements);
+        requirements = memoryRequirements.memoryRequirements;
+        dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+    } else {
+        requirements = bufferMemoryRequirements(buffer);
+    }
+
+    // large buffers would take up a big part of a shared block, they get memory of their own
+    const uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, usage);
+    if (dedicated || requirements.size >= m_allocator->dedicatedThreshold())
+        return m_allocator->allocateDedicated(requirements, memoryTypeIndex, m_hasDedicatedAllocation ? buffer->handle() : VK_NULL_HANDLE);
+    return m_allocator->allocate(requirements, memoryTypeIndex);
+}
+
+void Device::flushMappedMemoryRanges() const
+{
+    m_allocator->flushMappedRanges();
+}
+
+void Device::invalidateMappedMemoryRanges() const
+{
+    m_allocator->invalidateMappedRanges();
+}
+
+MemoryStatistics Device::memoryStatistics() const
+{
+    auto statistics = m_allocator->statistics();
+
+    if (m_hasMemoryBudget) {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT memoryBudgetProperties = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT
+        };
+        VkPhysicalDeviceMemoryProperties2KHR memoryProperties = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR,
+            .pNext = &memoryBudgetProperties
+        };
+        m_vkGetPhysicalDeviceMemoryProperties2(m_physicalDevice, &memoryProperties);
+
+        statistics.hasBudget = true;
+        for (size_t i = 0; i < statistics.heaps.size(); ++i) {
+            statistics.heaps[i].budget = memoryBudgetProperties.heapBudget[i];
+            statistics.heaps[i].budgetUsage = memoryBudgetProperties.heapUsage[i];
+        }
+    }
+
+    return statistics;
 }
 
 std::unique_ptr<Buffer> Device::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage) const
@@ -209,6 +433,11 @@ std::unique_ptr<Buffer> Device::createBuffer(VkDeviceSize size, VkBufferUsageFla
     return std::make_unique<Buffer>(this, size, usage);
 }
 
+std::unique_ptr<Buffer> Device::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memoryUsage) const
+{
+    return std::make_unique<Buffer>(this, size, usage, memoryUsage);
+}
+
 DescriptorSetLayoutBuilder Device::descriptorSetLayoutBuilder() const
 {
     return DescriptorSetLayoutBuilder(this);
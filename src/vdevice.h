@@ -1,6 +1,7 @@
 #pragma once
 
 #include "noncopyable.h"
+#include "vspan.h"
 
 #include <vulkan/vulkan.h>
 
@@ -11,28 +12,63 @@ struct GLFWwindow;
 namespace V {
 
 class Surface;
+class HostAllocator;
 class CommandPool;
 class ShaderModule;
 class Semaphore;
 class Fence;
 class PipelineLayoutBuilder;
 class PipelineBuilder;
+class PipelineCache;
+class ComputePipelineBuilder;
 class Memory;
+class Allocator;
+class Allocation;
 class Buffer;
 class DescriptorSetLayoutBuilder;
 class DescriptorPoolBuilder;
+struct MemoryStatistics;
+
+enum class MemoryUsage {
+    GpuOnly, // device local, only accessed by the GPU
+    Upload, // host visible, written once by the CPU and read by the GPU (staging)
+    Readback, // host visible and preferably cached, written by the GPU and read back by the CPU
+    Dynamic, // device local and host visible if the device has such memory, otherwise same as Upload
+};
 
 class Device : private NonCopyable
 {
 public:
     Device();
+    // hostAllocator receives the driver's host allocations; pass null to leave them to the driver.
+    // The pipeline cache is loaded from and saved to pipelineCachePath, unless it is null.
+    explicit Device(std::unique_ptr<HostAllocator> hostAllocator, const char *pipelineCachePath = nullptr);
     ~Device();
 
+    const VkAllocationCallbacks *allocationCallbacks() const;
+    const HostAllocator *hostAllocator() const { return m_hostAllocator.get(); }
+
     VkInstance instance() const { return m_instance; }
     VkPhysicalDevice physicalDevice() const { return m_physicalDevice; }
     uint32_t queueFamilyIndex() const { return m_queueFamilyIndex; }
     VkDevice device() const { return m_device; }
     VkQueue queue() const { return m_queue; }
+    uint32_t transferQueueFamilyIndex() const { return m_transferQueueFamilyIndex; }
+    VkQueue transferQueue() const { return m_transferQueue; }
+    bool hasDedicatedTransferQueue() const { return m_transferQueueFamilyIndex != m_queueFamilyIndex; }
+    // a compute queue without graphics support if the device has one, for work that overlaps rendering
+    uint32_t computeQueueFamilyIndex() const { return m_computeQueueFamilyIndex; }
+    VkQueue computeQueue() const { return m_computeQueue; }
+    bool hasDedicatedComputeQueue() const { return m_computeQueueFamilyIndex != m_queueFamilyIndex; }
+    const VkPhysicalDeviceProperties &properties() const { return m_properties; }
+    const VkPhysicalDeviceMemoryProperties &memoryProperties() const { return m_memoryProperties; }
+    // the optional features turned on at device creation, where supported: multiDrawIndirect, drawIndirectFirstInstance
+    const VkPhysicalDeviceFeatures &enabledFeatures() const { return m_enabledFeatures; }
+    bool hasMemoryBudget() const { return m_hasMemoryBudget; }
+    Allocator *allocator() const { return m_allocator.get(); }
+    PipelineCache *pipelineCache() const { return m_pipelineCache.get(); }
+
+    void waitIdle() const;
 
     VkMemoryRequirements bufferMemoryRequirements(const Buffer *buffer) const;
 
@@ -40,11 +76,21 @@ public:
     std::unique_ptr<Semaphore> createSemaphore() const;
     std::unique_ptr<Fence> createFence(bool createSignaled = false) const;
     std::unique_ptr<CommandPool> createCommandPool() const;
+    std::unique_ptr<CommandPool> createCommandPool(uint32_t queueFamilyIndex, VkCommandPoolCreateFlags flags = 0) const;
     std::unique_ptr<ShaderModule> createShaderModule(const char *spvFilePath) const;
+    std::unique_ptr<ShaderModule> createShaderModule(Span<const uint32_t> code) const;
     PipelineLayoutBuilder pipelineLayoutBuilder() const;
     PipelineBuilder pipelineBuilder() const;
-    std::unique_ptr<Memory> allocateMemory(VkDeviceSize size) const;
+    ComputePipelineBuilder computePipelineBuilder() const;
+    uint32_t findMemoryType(uint32_t memoryTypeBits, MemoryUsage usage) const;
+    std::unique_ptr<Allocation> allocateMemory(const VkMemoryRequirements &requirements, MemoryUsage usage) const;
+    std::unique_ptr<Allocation> allocateMemory(const Buffer *buffer, MemoryUsage usage) const;
+    MemoryStatistics memoryStatistics() const;
+    // hand the ranges queued with Memory::flush()/invalidate() to the driver, once per frame
+    void flushMappedMemoryRanges() const;
+    void invalidateMappedMemoryRanges() const;
     std::unique_ptr<Buffer> createBuffer(VkDeviceSize size, VkBufferUsageFlags usage) const;
+    std::unique_ptr<Buffer> createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memoryUsage) const;
     DescriptorSetLayoutBuilder descriptorSetLayoutBuilder() const;
     DescriptorPoolBuilder descriptorPoolBuilder() const;
 
@@ -53,11 +99,25 @@ private:
     void createDeviceAndQueue();
     void cleanup();
 
+    std::unique_ptr<HostAllocator> m_hostAllocator;
     VkInstance m_instance = VK_NULL_HANDLE;
     VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
     uint32_t m_queueFamilyIndex;
     VkDevice m_device = VK_NULL_HANDLE;
     VkQueue m_queue = VK_NULL_HANDLE;
+    uint32_t m_transferQueueFamilyIndex;
+    VkQueue m_transferQueue = VK_NULL_HANDLE;
+    uint32_t m_computeQueueFamilyIndex;
+    VkQueue m_computeQueue = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties m_properties;
+    VkPhysicalDeviceMemoryProperties m_memoryProperties;
+    VkPhysicalDeviceFeatures m_enabledFeatures = {};
+    PFN_vkGetPhysicalDeviceMemoryProperties2KHR m_vkGetPhysicalDeviceMemoryProperties2 = nullptr;
+    bool m_hasMemoryBudget = false;
+    PFN_vkGetBufferMemoryRequirements2KHR m_vkGetBufferMemoryRequirements2 = nullptr;
+    bool m_hasDedicatedAllocation = false;
+    std::unique_ptr<Allocator> m_allocator;
+    std::unique_ptr<PipelineCache> m_pipelineCache;
 };
 
 } // namespace V
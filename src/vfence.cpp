@@ -10,13 +10,18 @@ Fence::Fence(const Device *device, bool createSignaled)
         .flags = createSignaled ? VK_FENCE_CREATE_SIGNALED_BIT : 0u
     };
 
-    if (vkCreateFence(m_device->device(), &fenceCreateInfo, nullptr, &m_handle) != VK_SUCCESS)
+    if (vkCreateFence(m_device->device(), &fenceCreateInfo, m_device->allocationCallbacks(), &m_handle) != VK_SUCCESS)
         throw std::runtime_error("Failed to create fence");
 }
 
 Fence::~Fence()
 {
-    vkDestroyFence(m_device->device(), m_handle, nullptr);
+    vkDestroyFence(m_device->device(), m_handle, m_device->allocationCallbacks());
+}
+
+bool Fence::isSignaled() const
+{
+    return vkGetFenceStatus(m_device->device(), m_handle) == VK_SUCCESS;
 }
 
 void Fence::wait()
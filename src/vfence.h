@@ -15,6 +15,7 @@ public:
 
     VkFence handle() const { return m_handle; }
 
+    bool isSignaled() const;
     void reset();
     void wait();
 
@@ -0,0 +1,231 @@
+#include "vhostallocator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <sstream>
+
+namespace V {
+
+namespace {
+
+constexpr size_t ArenaChunkSize = 256 * 1024;
+constexpr size_t MaxArenaAllocationSize = ArenaChunkSize / 8;
+
+struct ArenaChunk {
+    std::atomic<size_t> referenceCount; // live allocations, plus one while the owning thread bumps out of it
+    size_t offset;
+    alignas(std::max_align_t) unsigned char data[ArenaChunkSize];
+};
+
+void releaseChunk(ArenaChunk *chunk)
+{
+    if (chunk->referenceCount.fetch_sub(1) == 1)
+        delete chunk;
+}
+
+// stored right in front of every allocation handed to the driver
+struct AllocationHeader {
+    ArenaChunk *chunk; // null for allocations from the system allocator
+    void *base;
+    size_t size;
+    VkSystemAllocationScope scope;
+};
+
+unsigned char *placeAllocation(unsigned char *start, size_t alignment)
+{
+    alignment = std::max(alignment, alignof(AllocationHeader));
+    const auto address = reinterpret_cast<uintptr_t>(start) + sizeof(AllocationHeader);
+    return reinterpret_cast<unsigned char *>((address + alignment - 1) & ~(uintptr_t(alignment) - 1));
+}
+
+class ThreadArena
+{
+public:
+    ~ThreadArena()
+    {
+        if (m_chunk)
+            releaseChunk(m_chunk);
+    }
+
+    // returns null if the request is too large for the arena
+    AllocationHeader *allocate(size_t size, size_t alignment)
+    {
+        const size_t worstCaseSize = sizeof(AllocationHeader) + std::max(alignment, alignof(AllocationHeader)) + size;
+        if (worstCaseSize > MaxArenaAllocationSize)
+            return nullptr;
+
+        // everything handed out from the chunk has been freed again, start over
+        if (m_chunk && m_chunk->referenceCount.load() == 1)
+            m_chunk->offset = 0;
+
+        if (!m_chunk || m_chunk->offset + worstCaseSize > ArenaChunkSize) {
+            if (m_chunk)
+                releaseChunk(m_chunk);
+            m_chunk = new ArenaChunk;
+            m_chunk->referenceCount = 1;
+            m_chunk->offset = 0;
+        }
+
+        unsigned char *memory = placeAllocation(m_chunk->data + m_chunk->offset, alignment);
+        m_chunk->offset = memory + size - m_chunk->data;
+        ++m_chunk->referenceCount;
+
+        auto *header = reinterpret_cast<AllocationHeader *>(memory) - 1;
+        header->chunk = m_chunk;
+        header->base = nullptr;
+        return header;
+    }
+
+private:
+    ArenaChunk *m_chunk = nullptr;
+};
+
+thread_local ThreadArena threadArena;
+
+AllocationHeader *headerOf(void *memory)
+{
+    return reinterpret_cast<AllocationHeader *>(memory) - 1;
+}
+
+} // namespace
+
+std::string HostAllocator::Statistics::toJson() const
+{
+    static const char *scopeNames[ScopeCount] = { "command", "object", "cache", "device", "instance" };
+
+    std::ostringstream out;
+    out << "{";
+    for (size_t i = 0; i < ScopeCount; ++i) {
+        const auto &scope = scopes[i];
+        out << (i > 0 ? ", " : "") << "\"" << scopeNames[i] << "\": {\"allocationCount\": " << scope.allocationCount
+            << ", \"allocatedBytes\": " << scope.allocatedBytes
+            << ", \"liveAllocationCount\": " << scope.liveAllocationCount
+            << ", \"liveBytes\": " << scope.liveBytes
+            << ", \"peakBytes\": " << scope.peakBytes
+            << ", \"internalBytes\": " << scope.internalBytes << "}";
+    }
+    out << "}";
+    return out.str();
+}
+
+HostAllocator::HostAllocator()
+    : m_callbacks {
+        .pUserData = this,
+        .pfnAllocation = &HostAllocator::allocationFunction,
+        .pfnReallocation = &HostAllocator::reallocationFunction,
+        .pfnFree = &HostAllocator::freeFunction,
+        .pfnInternalAllocation = &HostAllocator::internalAllocationNotification,
+        .pfnInternalFree = &HostAllocator::internalFreeNotification
+    }
+{
+}
+
+HostAllocator::~HostAllocator() = default;
+
+HostAllocator::Statistics HostAllocator::statistics() const
+{
+    Statistics statistics;
+    for (size_t i = 0; i < ScopeCount; ++i) {
+        statistics.scopes[i] = {
+            .allocationCount = m_counters[i].allocationCount,
+            .allocatedBytes = m_counters[i].allocatedBytes,
+            .liveAllocationCount = m_counters[i].liveAllocationCount,
+            .liveBytes = m_counters[i].liveBytes,
+            .peakBytes = m_counters[i].peakBytes,
+            .internalBytes = m_counters[i].internalBytes
+        };
+    }
+    return statistics;
+}
+
+void *HostAllocator::allocate(size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    AllocationHeader *header = nullptr;
+    if (scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND)
+        header = threadArena.allocate(size, alignment);
+
+    if (!header) {
+        void *base = std::malloc(sizeof(AllocationHeader) + std::max(alignment, alignof(AllocationHeader)) + size);
+        if (!base)
+            return nullptr;
+        header = reinterpret_cast<AllocationHeader *>(placeAllocation(static_cast<unsigned char *>(base), alignment)) - 1;
+        header->chunk = nullptr;
+        header->base = base;
+    }
+    header->size = size;
+    header->scope = scope;
+
+    auto &counters = m_counters[scope];
+    ++counters.allocationCount;
+    counters.allocatedBytes += size;
+    ++counters.liveAllocationCount;
+    const size_t liveBytes = counters.liveBytes += size;
+    size_t peakBytes = counters.peakBytes;
+    while (liveBytes > peakBytes && !counters.peakBytes.compare_exchange_weak(peakBytes, liveBytes)) { }
+
+    return header + 1;
+}
+
+void *HostAllocator::reallocate(void *original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    if (!original)
+        return allocate(size, alignment, scope);
+    if (size == 0) {
+        free(original);
+        return nullptr;
+    }
+
+    void *memory = allocate(size, alignment, scope);
+    if (memory) {
+        std::memcpy(memory, original, std::min(size, headerOf(original)->size));
+        free(original);
+    }
+    return memory;
+}
+
+void HostAllocator::free(void *memory)
+{
+    if (!memory)
+        return;
+
+    const AllocationHeader *header = headerOf(memory);
+
+    auto &counters = m_counters[header->scope];
+    --counters.liveAllocationCount;
+    counters.liveBytes -= header->size;
+
+    if (header->chunk)
+        releaseChunk(header->chunk);
+    else
+        std::free(header->base);
+}
+
+void *VKAPI_CALL HostAllocator::allocationFunction(void *userData, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    return static_cast<HostAllocator *>(userData)->allocate(size, alignment, scope);
+}
+
+void *VKAPI_CALL HostAllocator::reallocationFunction(void *userData, void *original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    return static_cast<HostAllocator *>(userData)->reallocate(original, size, alignment, scope);
+}
+
+void VKAPI_CALL HostAllocator::freeFunction(void *userData, void *memory)
+{
+    static_cast<HostAllocator *>(userData)->free(memory);
+}
+
+void VKAPI_CALL HostAllocator::internalAllocationNotification(void *userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope)
+{
+    static_cast<HostAllocator *>(userData)->m_counters[scope].internalBytes += size;
+}
+
+void VKAPI_CALL HostAllocator::internalFreeNotification(void *userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope)
+{
+    static_cast<HostAllocator *>(userData)->m_counters[scope].internalBytes -= size;
+}
+
+} // namespace V
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <atomic>
+#include <string>
+
+namespace V {
+
+// VkAllocationCallbacks for the driver's host allocations. Command scope allocations, which
+// only live for the duration of a single Vulkan call, are bumped out of a thread-local arena
+// that is rewound once everything in it has been freed; all other scopes go to the system
+// allocator. Allocations and bytes are counted per VkSystemAllocationScope.
+class HostAllocator : private NonCopyable
+{
+public:
+    static constexpr size_t ScopeCount = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+
+    struct ScopeStatistics {
+        size_t allocationCount = 0; // since creation
+        size_t allocatedBytes = 0; // since creation
+        size_t liveAllocationCount = 0;
+        size_t liveBytes = 0;
+        size_t peakBytes = 0;
+        size_t internalBytes = 0; // reported through the internal allocation notifications
+    };
+
+    struct Statistics {
+        std::array<ScopeStatistics, ScopeCount> scopes; // indexed by VkSystemAllocationScope
+
+        std::string toJson() const;
+    };
+
+    HostAllocator();
+    ~HostAllocator();
+
+    const VkAllocationCallbacks *callbacks() const { return &m_callbacks; }
+
+    Statistics statistics() const;
+
+private:
+    struct ScopeCounters {
+        std::atomic<size_t> allocationCount = 0;
+        std::atomic<size_t> allocatedBytes = 0;
+        std::atomic<size_t> liveAllocationCount = 0;
+        std::atomic<size_t> liveBytes = 0;
+        std::atomic<size_t> peakBytes = 0;
+        std::atomic<size_t> internalBytes = 0;
+    };
+
+    static void *VKAPI_CALL allocationFunction(void *userData, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    static void *VKAPI_CALL reallocationFunction(void *userData, void *original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    static void VKAPI_CALL freeFunction(void *userData, void *memory);
+    static void VKAPI_CALL internalAllocationNotification(void *userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+    static void VKAPI_CALL internalFreeNotification(void *userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+    void *allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+    void *reallocate(void *original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    void free(void *memory);
+
+    VkAllocationCallbacks m_callbacks;
+    std::array<ScopeCounters, ScopeCount> m_counters;
+};
+
+} // namespace V
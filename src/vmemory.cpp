@@ -1,19 +1,62 @@
 #include "vmemory.h"
 
+#include "util.h"
+#include "vallocator.h"
+
+#include <algorithm>
+
 namespace V {
 
 Memory::Memory(const Device *device, const VkMemoryAllocateInfo &allocateInfo)
     : m_device(device)
     , m_size(allocateInfo.allocationSize)
+    , m_memoryTypeIndex(allocateInfo.memoryTypeIndex)
 {
-    if (vkAllocateMemory(m_device->device(), &allocateInfo, nullptr, &m_handle) != VK_SUCCESS)
+    if (vkAllocateMemory(m_device->device(), &allocateInfo, m_device->allocationCallbacks(), &m_handle) != VK_SUCCESS)
         throw std::runtime_error("Failed to allocate memory");
+
+    const VkMemoryType &memoryType = m_device->memoryProperties().memoryTypes[m_memoryTypeIndex];
+    m_hostCoherent = memoryType.propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    if (memoryType.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        if (vkMapMemory(m_device->device(), m_handle, 0, VK_WHOLE_SIZE, 0, &m_mappedData) != VK_SUCCESS) {
+            vkFreeMemory(m_device->device(), m_handle, m_device->allocationCallbacks());
+            throw std::runtime_error("Failed to map memory");
+        }
+    }
 }
 
 Memory::~Memory()
 {
+    if (m_mappedData)
+        vkUnmapMemory(m_device->device(), m_handle);
+
     if (m_handle != VK_NULL_HANDLE)
-        vkFreeMemory(m_device->device(), m_handle, nullptr);
+        vkFreeMemory(m_device->device(), m_handle, m_device->allocationCallbacks());
+}
+
+void Memory::flush(VkDeviceSize offset, VkDeviceSize size) const
+{
+    if (m_mappedData && !m_hostCoherent)
+        m_device->allocator()->queueFlush(atomAlignedRange(offset, size));
+}
+
+void Memory::invalidate(VkDeviceSize offset, VkDeviceSize size) const
+{
+    if (m_mappedData && !m_hostCoherent)
+        m_device->allocator()->queueInvalidate(atomAlignedRange(offset, size));
+}
+
+VkMappedMemoryRange Memory::atomAlignedRange(VkDeviceSize offset, VkDeviceSize size) const
+{
+    const VkDeviceSize atomSize = m_device->properties().limits.nonCoherentAtomSize;
+    const VkDeviceSize end = size == VK_WHOLE_SIZE ? m_size : std::min(alignUp(offset + size, atomSize), m_size);
+    const VkDeviceSize start = offset - offset % atomSize;
+    return {
+        .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        .memory = m_handle,
+        .offset = start,
+        .size = end - start
+    };
 }
 
 } // namespace V
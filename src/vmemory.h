@@ -2,6 +2,8 @@
 
 #include "vdevice.h"
 
+#include <stdexcept>
+
 namespace V {
 
 class Memory : private NonCopyable
@@ -14,33 +16,38 @@ public:
     VkDevice deviceHandle() const { return m_device->device(); }
 
     VkDeviceSize size() const { return m_size; }
+    uint32_t memoryTypeIndex() const { return m_memoryTypeIndex; }
 
     VkDeviceMemory handle() const { return m_handle; }
 
-    template<typename T>
-    T *map(VkDeviceSize offset, VkDeviceSize size) const
-    {
-        T *buffer;
-        if (vkMapMemory(m_device->device(), m_handle, offset, size, 0, reinterpret_cast<void **>(&buffer)) != VK_SUCCESS)
-            throw std::runtime_error("Failed to map memory");
-        return buffer;
-    }
+    bool isHostVisible() const { return m_mappedData != nullptr; }
+    bool isHostCoherent() const { return m_hostCoherent; }
 
-    template<typename T>
-    T *map() const
-    {
-        return map<T>(0, m_size);
-    }
+    // Host writes to and GPU writes read back from non-coherent memory have to be made visible.
+    // The ranges are widened to nonCoherentAtomSize and queued; Device::flushMappedMemoryRanges()
+    // and Device::invalidateMappedMemoryRanges() hand everything queued to the driver at once.
+    // Both are no-ops on coherent memory.
+    void flush(VkDeviceSize offset, VkDeviceSize size) const;
+    void invalidate(VkDeviceSize offset, VkDeviceSize size) const;
 
-    void unmap()
+    // host visible memory stays mapped for as long as it is allocated
+    template<typename T>
+    T *map(VkDeviceSize offset = 0) const
     {
-        vkUnmapMemory(m_device->device(), m_handle);
+        if (!m_mappedData)
+            throw std::runtime_error("Memory is not host visible");
+        return reinterpret_cast<T *>(static_cast<uint8_t *>(m_mappedData) + offset);
     }
 
 private:
+    VkMappedMemoryRange atomAlignedRange(VkDeviceSize offset, VkDeviceSize size) const;
+
     const Device *m_device;
     VkDeviceSize m_size;
+    uint32_t m_memoryTypeIndex;
+    bool m_hostCoherent;
     VkDeviceMemory m_handle = VK_NULL_HANDLE;
+    void *m_mappedData = nullptr;
 };
 
 } // namespace V
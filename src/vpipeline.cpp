@@ -1,14 +1,53 @@
 #include "vpipeline.h"
 
 #include "vdevice.h"
+#include "vpipelinecache.h"
 #include "vpipelinelayout.h"
 #include "vshadermodule.h"
 #include "vswapchain.h"
 
+#include "util.h"
+
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
+#include <string_view>
 
 namespace V {
 
+namespace {
+
+// for Vulkan structures without padding or pointers
+template<typename T>
+bool equalBytes(const T &a, const T &b)
+{
+    return std::memcmp(&a, &b, sizeof(T)) == 0;
+}
+
+template<typename T, size_t N>
+bool equalBytes(const StaticVector<T, N> &a, const StaticVector<T, N> &b)
+{
+    return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+template<typename T>
+void hashWords(size_t &seed, const T &value)
+{
+    static_assert(sizeof(T) % sizeof(uint32_t) == 0);
+    uint32_t words[sizeof(T) / sizeof(uint32_t)];
+    std::memcpy(words, &value, sizeof(T));
+    for (uint32_t word : words)
+        hashCombine(seed, word);
+}
+
+bool equalShaderStages(const VkPipelineShaderStageCreateInfo &a, const VkPipelineShaderStageCreateInfo &b)
+{
+    // the modules are compared by PipelineBuilder::m_shaderModuleIds
+    return a.stage == b.stage && std::strcmp(a.pName, b.pName) == 0;
+}
+
+} // namespace
+
 PipelineBuilder::PipelineBuilder(const Device *device)
     : m_device(device)
 {
@@ -51,10 +90,24 @@ PipelineBuilder &PipelineBuilder::setViewport(uint32_t width, uint32_t height)
         .offset = VkOffset2D { 0, 0 },
         .extent = VkExtent2D { width, height },
     };
+
+    StaticVector<VkDynamicState, 9> dynamicStates;
+    for (auto dynamicState : m_dynamicStates) {
+        if (dynamicState != VK_DYNAMIC_STATE_VIEWPORT && dynamicState != VK_DYNAMIC_STATE_SCISSOR)
+            dynamicStates.push_back(dynamicState);
+    }
+    m_dynamicStates = dynamicStates;
     return *this;
 }
 
-PipelineBuilder &PipelineBuilder::addShaderStage(VkShaderStageFlagBits stage, ShaderModule *module)
+PipelineBuilder &PipelineBuilder::addDynamicState(VkDynamicState dynamicState)
+{
+    if (std::find(m_dynamicStates.begin(), m_dynamicStates.end(), dynamicState) == m_dynamicStates.end())
+        m_dynamicStates.push_back(dynamicState);
+    return *this;
+}
+
+PipelineBuilder &PipelineBuilder::addShaderStage(VkShaderStageFlagBits stage, ShaderModule *module, const SpecializationConstants &specializationConstants)
 {
     VkPipelineShaderStageCreateInfo shaderStage = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
@@ -63,11 +116,23 @@ PipelineBuilder &PipelineBuilder::addShaderStage(VkShaderStageFlagBits stage, Sh
         .pName = "main",
     };
     m_shaderStages.push_back(shaderStage);
+    m_shaderModuleIds.push_back(module->id());
+    m_specializationConstants.push_back(specializationConstants);
     return *this;
 }
 
 std::unique_ptr<Pipeline> PipelineBuilder::create(const PipelineLayout *layout, VkRenderPass renderPass) const
 {
+    // builders are copied around, so the pointers to the specialization info are only set up here
+    StaticVector<VkSpecializationInfo, 5> specializationInfos;
+    auto shaderStages = m_shaderStages;
+    for (size_t i = 0; i < shaderStages.size(); ++i) {
+        if (m_specializationConstants[i].empty())
+            continue;
+        specializationInfos.push_back(m_specializationConstants[i].info());
+        shaderStages[i].pSpecializationInfo = &specializationInfos.back();
+    }
+
     VkPipelineVertexInputStateCreateInfo vertexInputState = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
         .vertexBindingDescriptionCount = static_cast<uint32_t>(m_vertexInputBindings.size()),
@@ -80,12 +145,15 @@ std::unique_ptr<Pipeline> PipelineBuilder::create(const PipelineLayout *layout,
         .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
         .primitiveRestartEnable = VK_FALSE
     };
+    const auto isDynamic = [this](VkDynamicState dynamicState) {
+        return std::find(m_dynamicStates.begin(), m_dynamicStates.end(), dynamicState) != m_dynamicStates.end();
+    };
     VkPipelineViewportStateCreateInfo viewportState = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
         .viewportCount = 1,
-        .pViewports = &m_viewport,
+        .pViewports = isDynamic(VK_DYNAMIC_STATE_VIEWPORT) ? nullptr : &m_viewport,
         .scissorCount = 1,
-        .pScissors = &m_scissor
+        .pScissors = isDynamic(VK_DYNAMIC_STATE_SCISSOR) ? nullptr : &m_scissor
     };
     VkPipelineRasterizationStateCreateInfo rasterizationState = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
@@ -127,10 +195,15 @@ std::unique_ptr<Pipeline> PipelineBuilder::create(const PipelineLayout *layout,
         .pAttachments = &colorBlendAttachmentState,
         .blendConstants = { 0.0f, 0.0f, 0.0f, 0.0f }
     };
+    VkPipelineDynamicStateCreateInfo dynamicState = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = static_cast<uint32_t>(m_dynamicStates.size()),
+        .pDynamicStates = m_dynamicStates.data()
+    };
     VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-        .stageCount = static_cast<uint32_t>(m_shaderStages.size()),
-        .pStages = m_shaderStages.empty() ? nullptr : m_shaderStages.data(),
+        .stageCount = static_cast<uint32_t>(shaderStages.size()),
+        .pStages = shaderStages.empty() ? nullptr : shaderStages.data(),
         .pVertexInputState = &vertexInputState,
         .pInputAssemblyState = &inputAssemblyState,
         .pViewportState = &viewportState,
@@ -138,7 +211,7 @@ std::unique_ptr<Pipeline> PipelineBuilder::create(const PipelineLayout *layout,
         .pMultisampleState = &multisampleState,
         .pDepthStencilState = nullptr,
         .pColorBlendState = &colorBlendState,
-        .pDynamicState = nullptr,
+        .pDynamicState = m_dynamicStates.empty() ? nullptr : &dynamicState,
         .layout = layout->handle(),
         .renderPass = renderPass,
         .subpass = 0,
@@ -148,17 +221,94 @@ std::unique_ptr<Pipeline> PipelineBuilder::create(const PipelineLayout *layout,
     return std::make_unique<Pipeline>(m_device, graphicsPipelineCreateInfo);
 }
 
+size_t PipelineBuilder::hash() const
+{
+    size_t seed = 0;
+    for (const auto &binding : m_vertexInputBindings)
+        hashWords(seed, binding);
+    for (const auto &attribute : m_vertexInputAttributes)
+        hashWords(seed, attribute);
+    hashWords(seed, m_viewport);
+    hashWords(seed, m_scissor);
+    for (auto dynamicState : m_dynamicStates)
+        hashCombine(seed, static_cast<uint32_t>(dynamicState));
+    for (const auto &shaderStage : m_shaderStages) {
+        hashCombine(seed, static_cast<uint32_t>(shaderStage.stage));
+        hashCombine(seed, std::string_view(shaderStage.pName));
+    }
+    for (uint64_t shaderModuleId : m_shaderModuleIds)
+        hashCombine(seed, shaderModuleId);
+    for (const auto &specializationConstants : m_specializationConstants)
+        hashCombine(seed, specializationConstants.hash());
+    return seed;
+}
+
+bool PipelineBuilder::operator==(const PipelineBuilder &other) const
+{
+    return m_device == other.m_device && equalBytes(m_vertexInputBindings, other.m_vertexInputBindings) && equalBytes(m_vertexInputAttributes, other.m_vertexInputAttributes) && equalBytes(m_viewport, other.m_viewport) && equalBytes(m_scissor, other.m_scissor) && m_dynamicStates == other.m_dynamicStates && std::equal(m_shaderStages.begin(), m_shaderStages.end(), other.m_shaderStages.begin(), other.m_shaderStages.end(), equalShaderStages) && m_shaderModuleIds == other.m_shaderModuleIds && std::equal(m_specializationConstants.begin(), m_specializationConstants.end(), other.m_specializationConstants.begin(), other.m_specializationConstants.end());
+}
+
+ComputePipelineBuilder::ComputePipelineBuilder(const Device *device)
+    : m_device(device)
+{
+}
+
+ComputePipelineBuilder &ComputePipelineBuilder::setShader(ShaderModule *module, const SpecializationConstants &specializationConstants)
+{
+    m_shaderStage = VkPipelineShaderStageCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+        .module = module->handle(),
+        .pName = "main",
+    };
+    m_specializationConstants = specializationConstants;
+    return *this;
+}
+
+std::unique_ptr<Pipeline> ComputePipelineBuilder::create(const PipelineLayout *layout) const
+{
+    if (m_shaderStage.module == VK_NULL_HANDLE)
+        throw std::runtime_error("Compute pipeline has no shader");
+
+    const VkSpecializationInfo specializationInfo = m_specializationConstants.info();
+    auto shaderStage = m_shaderStage;
+    if (!m_specializationConstants.empty())
+        shaderStage.pSpecializationInfo = &specializationInfo;
+
+    VkComputePipelineCreateInfo computePipelineCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = shaderStage,
+        .layout = layout->handle(),
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex = -1
+    };
+    return std::make_unique<Pipeline>(m_device, computePipelineCreateInfo);
+}
+
 Pipeline::Pipeline(const Device *device, const VkGraphicsPipelineCreateInfo &createInfo)
     : m_device(device)
+    , m_bindPoint(VK_PIPELINE_BIND_POINT_GRAPHICS)
 {
-    if (vkCreateGraphicsPipelines(m_device->device(), VK_NULL_HANDLE, 1, &createInfo, nullptr, &m_handle) != VK_SUCCESS)
+    const auto start = std::chrono::steady_clock::now();
+    if (vkCreateGraphicsPipelines(m_device->device(), m_device->pipelineCache()->handle(), 1, &createInfo, m_device->allocationCallbacks(), &m_handle) != VK_SUCCESS)
         throw std::runtime_error("Failed to create pipeline");
+    m_compileTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+}
+
+Pipeline::Pipeline(const Device *device, const VkComputePipelineCreateInfo &createInfo)
+    : m_device(device)
+    , m_bindPoint(VK_PIPELINE_BIND_POINT_COMPUTE)
+{
+    const auto start = std::chrono::steady_clock::now();
+    if (vkCreateComputePipelines(m_device->device(), m_device->pipelineCache()->handle(), 1, &createInfo, m_device->allocationCallbacks(), &m_handle) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create compute pipeline");
+    m_compileTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
 }
 
 Pipeline::~Pipeline()
 {
     if (m_handle != VK_NULL_HANDLE)
-        vkDestroyPipeline(m_device->device(), m_handle, nullptr);
+        vkDestroyPipeline(m_device->device(), m_handle, m_device->allocationCallbacks());
 }
 
 } // namespace V
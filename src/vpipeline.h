@@ -1,8 +1,10 @@
 #pragma once
 
 #include "vdevice.h"
+#include "vspecializationconstants.h"
+#include "vstaticvector.h"
 
-#include <vector>
+#include <chrono>
 
 namespace V {
 
@@ -17,34 +19,70 @@ public:
 
     PipelineBuilder &addVertexInputBinding(uint32_t binding, uint32_t stride);
     PipelineBuilder &addVertexInputAttribute(uint32_t location, uint32_t binding, VkFormat format, uint32_t offset);
+    // Viewport and scissor are dynamic unless set here, see CommandBuffer::setViewport(). A
+    // static viewport saves a command per render pass, but the pipeline has to be recreated
+    // when the window is resized.
     PipelineBuilder &setViewport(uint32_t width, uint32_t height);
-    PipelineBuilder &addShaderStage(VkShaderStageFlagBits stage, ShaderModule *module);
+    PipelineBuilder &addDynamicState(VkDynamicState dynamicState);
+    // the specialization constants are part of the pipeline, see hash()
+    PipelineBuilder &addShaderStage(VkShaderStageFlagBits stage, ShaderModule *module, const SpecializationConstants &specializationConstants = {});
 
     std::unique_ptr<Pipeline> create(const PipelineLayout *layout, VkRenderPass renderPass) const;
 
+    // over everything create() would pass to the driver, except the layout and render pass;
+    // shader modules are told apart by ShaderModule::id()
+    size_t hash() const;
+    bool operator==(const PipelineBuilder &other) const;
+    bool operator!=(const PipelineBuilder &other) const { return !(*this == other); }
+
 private:
     const Device *m_device;
-    std::vector<VkVertexInputBindingDescription> m_vertexInputBindings;
-    std::vector<VkVertexInputAttributeDescription> m_vertexInputAttributes;
-    VkViewport m_viewport;
-    VkRect2D m_scissor;
-    std::vector<VkPipelineShaderStageCreateInfo> m_shaderStages;
+    StaticVector<VkVertexInputBindingDescription, 16> m_vertexInputBindings;
+    StaticVector<VkVertexInputAttributeDescription, 16> m_vertexInputAttributes;
+    VkViewport m_viewport = {};
+    VkRect2D m_scissor = {};
+    StaticVector<VkDynamicState, 9> m_dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    StaticVector<VkPipelineShaderStageCreateInfo, 5> m_shaderStages;
+    StaticVector<uint64_t, 5> m_shaderModuleIds; // one per shader stage
+    StaticVector<SpecializationConstants, 5> m_specializationConstants; // one per shader stage
+};
+
+class ComputePipelineBuilder
+{
+public:
+    explicit ComputePipelineBuilder(const Device *device);
+
+    ComputePipelineBuilder &setShader(ShaderModule *module, const SpecializationConstants &specializationConstants = {});
+
+    std::unique_ptr<Pipeline> create(const PipelineLayout *layout) const;
+
+private:
+    const Device *m_device;
+    VkPipelineShaderStageCreateInfo m_shaderStage = {};
+    SpecializationConstants m_specializationConstants;
 };
 
 class Pipeline : private NonCopyable
 {
 public:
     explicit Pipeline(const Device *device, const VkGraphicsPipelineCreateInfo &createInfo);
+    explicit Pipeline(const Device *device, const VkComputePipelineCreateInfo &createInfo);
     ~Pipeline();
 
     const Device *device() const { return m_device; }
     VkDevice deviceHandle() const { return m_device->device(); }
 
     VkPipeline handle() const { return m_handle; }
+    VkPipelineBindPoint bindPoint() const { return m_bindPoint; }
+
+    // time spent in vkCreate*Pipelines, short when the pipeline cache had it
+    std::chrono::microseconds compileTime() const { return m_compileTime; }
 
 private:
     const Device *m_device;
+    VkPipelineBindPoint m_bindPoint;
     VkPipeline m_handle = VK_NULL_HANDLE;
+    std::chrono::microseconds m_compileTime;
 };
 
 } // namespace V
@@ -0,0 +1,103 @@
+#include "vpipelinecache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace V {
+
+PipelineCache::PipelineCache(const Device *device, const char *path)
+    : m_device(device)
+    , m_path(path ? path : "")
+{
+    auto initialData = load();
+    if (!isCompatible(m_device->properties(), initialData))
+        initialData.clear();
+
+    VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = initialData.size(),
+        .pInitialData = initialData.empty() ? nullptr : initialData.data()
+    };
+
+    if (vkCreatePipelineCache(m_device->device(), &pipelineCacheCreateInfo, m_device->allocationCallbacks(), &m_handle) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create pipeline cache");
+    m_loadedSize = initialData.size();
+}
+
+PipelineCache::~PipelineCache()
+{
+    if (m_handle != VK_NULL_HANDLE) {
+        save();
+        vkDestroyPipelineCache(m_device->device(), m_handle, m_device->allocationCallbacks());
+    }
+}
+
+std::vector<uint8_t> PipelineCache::load() const
+{
+    if (m_path.empty())
+        return {};
+
+    // a missing file is a cold start, not an error
+    std::ifstream file(m_path, std::ios::binary);
+    if (!file.is_open())
+        return {};
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+std::vector<uint8_t> PipelineCache::data() const
+{
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(m_device->device(), m_handle, &dataSize, nullptr) != VK_SUCCESS)
+        throw std::runtime_error("Failed to get pipeline cache data");
+
+    std::vector<uint8_t> data(dataSize);
+    if (dataSize != 0 && vkGetPipelineCacheData(m_device->device(), m_handle, &dataSize, data.data()) != VK_SUCCESS)
+        throw std::runtime_error("Failed to get pipeline cache data");
+    data.resize(dataSize);
+    return data;
+}
+
+bool PipelineCache::save() const
+{
+    if (m_path.empty())
+        return false;
+
+    std::vector<uint8_t> cacheData;
+    try {
+        cacheData = data();
+    } catch (const std::runtime_error &) {
+        return false;
+    }
+    if (cacheData.empty())
+        return false;
+
+    // never leave a truncated file behind, another process may be loading it
+    const std::string temporaryPath = m_path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            return false;
+        file.write(reinterpret_cast<const char *>(cacheData.data()), cacheData.size());
+        if (!file)
+            return false;
+    }
+    return std::rename(temporaryPath.c_str(), m_path.c_str()) == 0;
+}
+
+bool PipelineCache::isCompatible(const VkPhysicalDeviceProperties &properties, const std::vector<uint8_t> &data)
+{
+    // VK_PIPELINE_CACHE_HEADER_VERSION_ONE: length, version, vendor ID, device ID, cache UUID
+    constexpr size_t HeaderSize = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+    if (data.size() < HeaderSize)
+        return false;
+
+    uint32_t header[4];
+    std::memcpy(header, data.data(), sizeof(header));
+    const auto [headerLength, headerVersion, vendorID, deviceID] = header;
+    return headerLength >= HeaderSize && headerLength <= data.size() && headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE && vendorID == properties.vendorID && deviceID == properties.deviceID && std::memcmp(data.data() + sizeof(header), properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+} // namespace V
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "vdevice.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace V {
+
+// A VkPipelineCache persisted to a file. Data written by another driver or device, as told by
+// the cache header, is ignored: pipelines are then compiled from SPIR-V and the file is
+// replaced on save().
+class PipelineCache : private NonCopyable
+{
+public:
+    // path may be null for a cache that only lives as long as the device
+    explicit PipelineCache(const Device *device, const char *path);
+    ~PipelineCache(); // saves
+
+    const Device *device() const { return m_device; }
+    VkDevice deviceHandle() const { return m_device->device(); }
+
+    VkPipelineCache handle() const { return m_handle; }
+    const std::string &path() const { return m_path; }
+
+    // size of the data loaded from the file, 0 if there was no usable file
+    size_t loadedSize() const { return m_loadedSize; }
+
+    std::vector<uint8_t> data() const;
+    // writes to a temporary file that is then renamed over path, returns false on failure
+    bool save() const;
+
+    // checks the header of data against the device that would use it
+    static bool isCompatible(const VkPhysicalDeviceProperties &properties, const std::vector<uint8_t> &data);
+
+private:
+    std::vector<uint8_t> load() const;
+
+    const Device *m_device;
+    std::string m_path;
+    VkPipelineCache m_handle = VK_NULL_HANDLE;
+    size_t m_loadedSize = 0;
+};
+
+} // namespace V
@@ -0,0 +1,93 @@
+#include "vpipelinecompiler.h"
+
+#include <algorithm>
+
+namespace V {
+
+PipelineCompiler::PipelineCompiler(const Device *device, uint32_t threadCount)
+    : m_device(device)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    threadCount = std::max(1u, threadCount);
+
+    m_threads.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; ++i)
+        m_threads.emplace_back(&PipelineCompiler::run, this);
+}
+
+PipelineCompiler::~PipelineCompiler()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_workAvailable.notify_all();
+    for (auto &thread : m_threads)
+        thread.join();
+}
+
+std::future<std::unique_ptr<Pipeline>> PipelineCompiler::compile(const PipelineBuilder &builder, const PipelineLayout *layout, VkRenderPass renderPass)
+{
+    return enqueue([builder, layout, renderPass] {
+        return builder.create(layout, renderPass);
+    });
+}
+
+std::future<std::unique_ptr<Pipeline>> PipelineCompiler::compile(const ComputePipelineBuilder &builder, const PipelineLayout *layout)
+{
+    return enqueue([builder, layout] {
+        return builder.create(layout);
+    });
+}
+
+std::future<std::unique_ptr<Pipeline>> PipelineCompiler::enqueue(std::function<std::unique_ptr<Pipeline>()> create)
+{
+    std::packaged_task<std::unique_ptr<Pipeline>()> task(std::move(create));
+    auto future = task.get_future();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(std::move(task));
+        ++m_pendingCount;
+    }
+    m_workAvailable.notify_one();
+    return future;
+}
+
+size_t PipelineCompiler::pendingCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pendingCount;
+}
+
+void PipelineCompiler::waitIdle()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this] { return m_pendingCount == 0; });
+}
+
+void PipelineCompiler::run()
+{
+    for (;;) {
+        std::packaged_task<std::unique_ptr<Pipeline>()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_workAvailable.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+            if (m_queue.empty())
+                return;
+            task = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        // exceptions thrown by the driver wrappers end up in the future
+        task();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_pendingCount;
+        }
+        m_idle.notify_all();
+    }
+}
+
+} // namespace V
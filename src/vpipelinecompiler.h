@@ -0,0 +1,49 @@
+#pragma once
+
+#include "vpipeline.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace V {
+
+// Compiles pipelines on a pool of worker threads, so the calling thread can keep rendering while
+// they build. The builders are copied, but the shader modules, layouts and render passes they
+// refer to must stay alive until the returned future is ready. The workers share the pipeline
+// cache of the device, which Vulkan synchronizes internally.
+class PipelineCompiler : private NonCopyable
+{
+public:
+    // threadCount 0 leaves one hardware thread for the caller
+    explicit PipelineCompiler(const Device *device, uint32_t threadCount = 0);
+    ~PipelineCompiler(); // finishes the queued pipelines
+
+    uint32_t threadCount() const { return static_cast<uint32_t>(m_threads.size()); }
+
+    std::future<std::unique_ptr<Pipeline>> compile(const PipelineBuilder &builder, const PipelineLayout *layout, VkRenderPass renderPass);
+    std::future<std::unique_ptr<Pipeline>> compile(const ComputePipelineBuilder &builder, const PipelineLayout *layout);
+
+    // pipelines queued or being compiled
+    size_t pendingCount() const;
+    void waitIdle();
+
+private:
+    std::future<std::unique_ptr<Pipeline>> enqueue(std::function<std::unique_ptr<Pipeline>()> create);
+    void run();
+
+    const Device *m_device;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_idle;
+    std::deque<std::packaged_task<std::unique_ptr<Pipeline>()>> m_queue;
+    size_t m_pendingCount = 0;
+    bool m_stopping = false;
+    std::vector<std::thread> m_threads;
+};
+
+} // namespace V
@@ -2,6 +2,7 @@
 
 #include "vdescriptorsetlayout.h"
 
+#include <atomic>
 #include <stdexcept>
 
 namespace V {
@@ -17,12 +18,28 @@ PipelineLayoutBuilder &PipelineLayoutBuilder::addSetLayout(const DescriptorSetLa
     return *this;
 }
 
+PipelineLayoutBuilder &PipelineLayoutBuilder::addPushConstantRange(VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size)
+{
+    if (offset % 4 != 0 || size % 4 != 0 || size == 0 || offset + size > m_device->properties().limits.maxPushConstantsSize)
+        throw std::runtime_error("Invalid push constant range");
+
+    VkPushConstantRange pushConstantRange = {
+        .stageFlags = stageFlags,
+        .offset = offset,
+        .size = size
+    };
+    m_pushConstantRanges.push_back(pushConstantRange);
+    return *this;
+}
+
 std::unique_ptr<PipelineLayout> PipelineLayoutBuilder::create() const
 {
     VkPipelineLayoutCreateInfo createInfo = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
         .setLayoutCount = static_cast<uint32_t>(m_setLayouts.size()),
         .pSetLayouts = m_setLayouts.empty() ? nullptr : m_setLayouts.data(),
+        .pushConstantRangeCount = static_cast<uint32_t>(m_pushConstantRanges.size()),
+        .pPushConstantRanges = m_pushConstantRanges.empty() ? nullptr : m_pushConstantRanges.data()
     };
     return std::make_unique<PipelineLayout>(m_device, createInfo);
 }
@@ -30,14 +47,54 @@ std::unique_ptr<PipelineLayout> PipelineLayoutBuilder::create() const
 PipelineLayout::PipelineLayout(const Device *device, const VkPipelineLayoutCreateInfo &createInfo)
     : m_device(device)
 {
-    if (vkCreatePipelineLayout(m_device->device(), &createInfo, nullptr, &m_handle) != VK_SUCCESS)
+    static std::atomic<uint64_t> nextId = 1;
+    m_id = nextId++;
+
+    if (vkCreatePipelineLayout(m_device->device(), &createInfo, m_device->allocationCallbacks(), &m_handle) != VK_SUCCESS)
         throw std::runtime_error("Failed to create pipeline layout");
+
+    for (uint32_t i = 0; i < createInfo.pushConstantRangeCount; ++i)
+        m_pushConstantRanges.push_back(createInfo.pPushConstantRanges[i]);
 }
 
 PipelineLayout::~PipelineLayout()
 {
     if (m_handle != VK_NULL_HANDLE)
-        vkDestroyPipelineLayout(m_device->device(), m_handle, nullptr);
+        vkDestroyPipelineLayout(m_device->device(), m_handle, m_device->allocationCallbacks());
+}
+
+bool PipelineLayout::isValidPushConstantUpdate(VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size) const
+{
+    if (offset % 4 != 0 || size % 4 != 0 || size == 0 || stageFlags == 0)
+        return false;
+
+    // every range overlapping the update must have all of its stages updated...
+    const uint32_t end = offset + size;
+    for (const auto &range : m_pushConstantRanges) {
+        const bool overlaps = range.offset < end && offset < range.offset + range.size;
+        if (overlaps && (range.stageFlags & ~stageFlags) != 0)
+            return false;
+    }
+
+    // ...and for each updated stage, the ranges including it must cover the bytes
+    for (VkShaderStageFlags stage = 1; stage != 0 && stage <= stageFlags; stage <<= 1) {
+        if (!(stageFlags & stage))
+            continue;
+        uint32_t covered = offset;
+        bool extended = true;
+        while (covered < end && extended) {
+            extended = false;
+            for (const auto &range : m_pushConstantRanges) {
+                if ((range.stageFlags & stage) && range.offset <= covered && covered < range.offset + range.size) {
+                    covered = range.offset + range.size;
+                    extended = true;
+                }
+            }
+        }
+        if (covered < end)
+            return false;
+    }
+    return true;
 }
 
 } // namespace V
@@ -1,8 +1,8 @@
 #pragma once
 
 #include "vdevice.h"
-
-#include <vector>
+#include "vspan.h"
+#include "vstaticvector.h"
 
 namespace V {
 
@@ -15,12 +15,14 @@ public:
     explicit PipelineLayoutBuilder(const Device *device);
 
     PipelineLayoutBuilder &addSetLayout(const DescriptorSetLayout *setLayout);
+    PipelineLayoutBuilder &addPushConstantRange(VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size);
 
     std::unique_ptr<PipelineLayout> create() const;
 
 private:
     const Device *m_device;
-    std::vector<VkDescriptorSetLayout> m_setLayouts;
+    StaticVector<VkDescriptorSetLayout, 8> m_setLayouts;
+    StaticVector<VkPushConstantRange, 8> m_pushConstantRanges;
 };
 
 class PipelineLayout : private NonCopyable
@@ -33,10 +35,18 @@ public:
     VkDevice deviceHandle() const { return m_device->device(); }
 
     VkPipelineLayout handle() const { return m_handle; }
+    // unique for the lifetime of the process, unlike the handle which the driver may reuse
+    uint64_t id() const { return m_id; }
+
+    Span<const VkPushConstantRange> pushConstantRanges() const { return m_pushConstantRanges; }
+    // whether vkCmdPushConstants may update these bytes for these stages with this layout
+    bool isValidPushConstantUpdate(VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size) const;
 
 private:
     const Device *m_device;
     VkPipelineLayout m_handle = VK_NULL_HANDLE;
+    uint64_t m_id;
+    StaticVector<VkPushConstantRange, 8> m_pushConstantRanges;
 };
 
 } // namespace V
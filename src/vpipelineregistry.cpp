@@ -0,0 +1,115 @@
+#include "vpipelineregistry.h"
+
+#include "vpipelinelayout.h"
+
+#include "util.h"
+
+namespace V {
+
+namespace {
+
+constexpr size_t InitialCapacity = 64;
+
+size_t hashKey(const PipelineBuilder &builder, uint64_t layoutId, const RenderPassKey &renderPassKey)
+{
+    size_t hash = builder.hash();
+    hashCombine(hash, layoutId);
+    hashCombine(hash, renderPassKey.hash());
+    return hash;
+}
+
+} // namespace
+
+PipelineRegistry::Table::Table(size_t capacity)
+    : capacity(capacity)
+    , slots(new std::atomic<const Entry *>[capacity])
+{
+    for (size_t i = 0; i < capacity; ++i)
+        slots[i].store(nullptr, std::memory_order_relaxed);
+}
+
+PipelineRegistry::PipelineRegistry(const Device *device)
+    : m_device(device)
+{
+    m_tables.push_back(std::make_unique<Table>(InitialCapacity));
+    m_table.store(m_tables.back().get(), std::memory_order_release);
+}
+
+PipelineRegistry::~PipelineRegistry() = default;
+
+const Pipeline *PipelineRegistry::pipeline(const PipelineBuilder &builder, const PipelineLayout *layout, VkRenderPass renderPass, const RenderPassKey &renderPassKey)
+{
+    const size_t hash = hashKey(builder, layout->id(), renderPassKey);
+
+    if (const Entry *entry = find(m_table.load(std::memory_order_acquire), builder, layout->id(), renderPassKey, hash)) {
+        m_hits.fetch_add(1, std::memory_order_relaxed);
+        return entry->pipeline.get();
+    }
+
+    // compiled without holding the lock; if another thread registered the same pipeline
+    // meanwhile, this one is dropped
+    auto pipeline = builder.create(layout, renderPass);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Table *table = m_table.load(std::memory_order_relaxed);
+    if (const Entry *entry = find(table, builder, layout->id(), renderPassKey, hash)) {
+        m_hits.fetch_add(1, std::memory_order_relaxed);
+        return entry->pipeline.get();
+    }
+
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    m_compileTime.fetch_add(pipeline->compileTime().count(), std::memory_order_relaxed);
+
+    m_entries.push_back(std::make_unique<Entry>(Entry { builder, layout->id(), renderPassKey, hash, std::move(pipeline) }));
+    const Entry *entry = m_entries.back().get();
+
+    // keep the load factor at most one half, so probe sequences stay short
+    if (2 * m_entries.size() > table->capacity) {
+        auto newTable = std::make_unique<Table>(2 * table->capacity);
+        for (const auto &existingEntry : m_entries)
+            insert(newTable.get(), existingEntry.get());
+        m_tables.push_back(std::move(newTable));
+        m_table.store(m_tables.back().get(), std::memory_order_release);
+    } else {
+        insert(table, entry);
+    }
+    return entry->pipeline.get();
+}
+
+const PipelineRegistry::Entry *PipelineRegistry::find(const Table *table, const PipelineBuilder &builder, uint64_t layoutId, const RenderPassKey &renderPassKey, size_t hash)
+{
+    const size_t mask = table->capacity - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        const Entry *entry = table->slots[i].load(std::memory_order_acquire);
+        if (!entry)
+            return nullptr;
+        if (entry->hash == hash && entry->layoutId == layoutId && entry->renderPassKey == renderPassKey && entry->builder == builder)
+            return entry;
+    }
+}
+
+void PipelineRegistry::insert(Table *table, const Entry *entry)
+{
+    const size_t mask = table->capacity - 1;
+    size_t i = entry->hash & mask;
+    while (table->slots[i].load(std::memory_order_relaxed))
+        i = (i + 1) & mask;
+    table->slots[i].store(entry, std::memory_order_release);
+}
+
+size_t PipelineRegistry::pipelineCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+}
+
+PipelineRegistry::Statistics PipelineRegistry::statistics() const
+{
+    return {
+        .hits = m_hits.load(std::memory_order_relaxed),
+        .misses = m_misses.load(std::memory_order_relaxed),
+        .compileTime = std::chrono::microseconds(m_compileTime.load(std::memory_order_relaxed))
+    };
+}
+
+} // namespace V
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "vpipeline.h"
+#include "vrenderpasskey.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace V {
+
+// Hands out one Pipeline per distinct (builder state, layout, render pass compatibility), creating
+// it on the first request. Lookups of existing pipelines take no lock: they probe an open
+// addressing table that writers only ever add to, and that is replaced by a larger copy when it
+// fills up. Old tables are kept until the registry is destroyed, so a reader never sees one go
+// away. No key depends on handle values, which the driver may reuse once an object is destroyed:
+// layouts and shader modules are told apart by their id(), render passes by their RenderPassKey,
+// so a pipeline created for one render pass is handed out for every compatible one.
+class PipelineRegistry : private NonCopyable
+{
+public:
+    struct Statistics {
+        uint64_t hits = 0;
+        uint64_t misses = 0; // pipelines created
+        std::chrono::microseconds compileTime { 0 }; // spent creating the missed pipelines
+    };
+
+    explicit PipelineRegistry(const Device *device);
+    ~PipelineRegistry();
+
+    // thread safe; the pipeline lives as long as the registry. renderPassKey must describe
+    // renderPass, which is only used when the pipeline has to be created.
+    const Pipeline *pipeline(const PipelineBuilder &builder, const PipelineLayout *layout, VkRenderPass renderPass, const RenderPassKey &renderPassKey);
+
+    size_t pipelineCount() const;
+    Statistics statistics() const;
+
+private:
+    struct Entry {
+        PipelineBuilder builder;
+        uint64_t layoutId;
+        RenderPassKey renderPassKey;
+        size_t hash;
+        std::unique_ptr<Pipeline> pipeline;
+    };
+
+    struct Table {
+        explicit Table(size_t capacity);
+
+        size_t capacity; // power of two
+        std::unique_ptr<std::atomic<const Entry *>[]> slots;
+    };
+
+    static const Entry *find(const Table *table, const PipelineBuilder &builder, uint64_t layoutId, const RenderPassKey &renderPassKey, size_t hash);
+    static void insert(Table *table, const Entry *entry);
+
+    const Device *m_device;
+    std::atomic<Table *> m_table;
+    std::atomic<uint64_t> m_hits = 0;
+    std::atomic<uint64_t> m_misses = 0;
+    std::atomic<int64_t> m_compileTime = 0; // microseconds
+
+    mutable std::mutex m_mutex; // serializes writers
+    std::vector<std::unique_ptr<Entry>> m_entries;
+    std::vector<std::unique_ptr<Table>> m_tables; // the current one and the retired ones
+};
+
+} // namespace V
@@ -0,0 +1,53 @@
+#include "vrenderpasskey.h"
+
+#include "util.h"
+
+#include <cstring>
+#include <iterator>
+
+namespace V {
+
+RenderPassKey::RenderPassKey(const VkRenderPassCreateInfo &createInfo)
+{
+    // every attachment reference becomes its format and sample count, unused ones zeroes
+    const auto addReferences = [this, &createInfo](uint32_t count, const VkAttachmentReference *references) {
+        m_words.push_back(references ? count : 0);
+        for (uint32_t i = 0; references && i < count; ++i) {
+            const uint32_t attachment = references[i].attachment;
+            if (attachment == VK_ATTACHMENT_UNUSED) {
+                m_words.push_back(0);
+                m_words.push_back(0);
+            } else {
+                m_words.push_back(createInfo.pAttachments[attachment].format);
+                m_words.push_back(createInfo.pAttachments[attachment].samples);
+            }
+        }
+    };
+
+    m_words.push_back(createInfo.subpassCount);
+    for (uint32_t i = 0; i < createInfo.subpassCount; ++i) {
+        const VkSubpassDescription &subpass = createInfo.pSubpasses[i];
+        m_words.push_back(subpass.pipelineBindPoint);
+        addReferences(subpass.inputAttachmentCount, subpass.pInputAttachments);
+        addReferences(subpass.colorAttachmentCount, subpass.pColorAttachments);
+        addReferences(subpass.colorAttachmentCount, subpass.pResolveAttachments);
+        addReferences(1, subpass.pDepthStencilAttachment);
+    }
+
+    m_words.push_back(createInfo.dependencyCount);
+    for (uint32_t i = 0; i < createInfo.dependencyCount; ++i) {
+        uint32_t words[sizeof(VkSubpassDependency) / sizeof(uint32_t)];
+        std::memcpy(words, &createInfo.pDependencies[i], sizeof(words));
+        m_words.insert(m_words.end(), std::begin(words), std::end(words));
+    }
+}
+
+size_t RenderPassKey::hash() const
+{
+    size_t seed = 0;
+    for (uint32_t word : m_words)
+        hashCombine(seed, word);
+    return seed;
+}
+
+} // namespace V
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace V {
+
+// What makes render passes compatible in the Vulkan sense: the formats and sample counts of the
+// attachments each subpass references, and the subpass dependencies. Load and store operations
+// and image layouts are left out. Pipelines created for one render pass can be used with any
+// other that has an equal key.
+class RenderPassKey
+{
+public:
+    RenderPassKey() = default;
+    explicit RenderPassKey(const VkRenderPassCreateInfo &createInfo);
+
+    size_t hash() const;
+    bool operator==(const RenderPassKey &other) const { return m_words == other.m_words; }
+    bool operator!=(const RenderPassKey &other) const { return !(*this == other); }
+
+private:
+    std::vector<uint32_t> m_words;
+};
+
+} // namespace V
@@ -0,0 +1,66 @@
+#include "vringbuffer.h"
+
+#include "vallocator.h"
+#include "vfence.h"
+
+#include "util.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace V {
+
+RingBuffer::RingBuffer(const Device *device, VkDeviceSize frameSize, uint32_t frameCount, VkBufferUsageFlags usage)
+    : m_device(device)
+    , m_frameCount(frameCount)
+{
+    // every slice must be usable as a uniform or storage buffer descriptor offset
+    const VkPhysicalDeviceLimits &limits = m_device->properties().limits;
+    m_minAlignment = 16;
+    if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+        m_minAlignment = std::max(m_minAlignment, limits.minUniformBufferOffsetAlignment);
+    if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+        m_minAlignment = std::max(m_minAlignment, limits.minStorageBufferOffsetAlignment);
+
+    m_frameSize = alignUp(frameSize, m_minAlignment);
+
+    m_buffer = m_device->createBuffer(m_frameSize * m_frameCount, usage, MemoryUsage::Dynamic);
+    m_mappedData = m_buffer->allocation()->map<uint8_t>();
+}
+
+RingBuffer::~RingBuffer() = default;
+
+void RingBuffer::beginFrame(uint32_t frameIndex, Fence *fence)
+{
+    // the GPU may still be reading the partition until then
+    fence->wait();
+    m_frameStart = (frameIndex % m_frameCount) * m_frameSize;
+    m_frameOffset = 0;
+}
+
+void RingBuffer::flush() const
+{
+    if (m_frameOffset > 0)
+        m_buffer->allocation()->flush(m_frameStart, m_frameOffset);
+}
+
+RingBuffer::Slice RingBuffer::allocate(VkDeviceSize size)
+{
+    return allocate(size, m_minAlignment);
+}
+
+RingBuffer::Slice RingBuffer::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+    // the frame start is only a multiple of the minimum alignment, align the offset in the buffer
+    const VkDeviceSize offset = alignUp(m_frameStart + m_frameOffset, std::max(alignment, m_minAlignment)) - m_frameStart;
+    if (offset + size > m_frameSize)
+        throw std::runtime_error("Ring buffer frame is full");
+    m_frameOffset = offset + size;
+
+    return {
+        .bufferSlice = { m_buffer.get(), m_frameStart + offset, size },
+        .data = m_mappedData + m_frameStart + offset
+    };
+}
+
+} // namespace V
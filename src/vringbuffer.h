@@ -0,0 +1,58 @@
+#pragma once
+
+#include "vbuffer.h"
+
+namespace V {
+
+class Fence;
+
+// A persistently mapped buffer for data that is rewritten every frame. The buffer is split
+// into one partition per frame in flight; slices are handed out from the current partition
+// with a bump pointer, and the whole partition is reclaimed at once when the frame comes
+// around again.
+class RingBuffer : private NonCopyable
+{
+public:
+    struct Slice {
+        BufferSlice bufferSlice;
+        void *data;
+    };
+
+    explicit RingBuffer(const Device *device, VkDeviceSize frameSize, uint32_t frameCount, VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    ~RingBuffer();
+
+    const Buffer *buffer() const { return m_buffer.get(); }
+    VkDeviceSize frameSize() const { return m_frameSize; }
+    uint32_t frameCount() const { return m_frameCount; }
+
+    // Waits for fence, the fence of the submission that last used frameIndex's partition, and
+    // starts allocating from that partition. Call before the fence is reset for the new frame.
+    void beginFrame(uint32_t frameIndex, Fence *fence);
+
+    Slice allocate(VkDeviceSize size);
+    Slice allocate(VkDeviceSize size, VkDeviceSize alignment);
+
+    // Queues a flush of everything allocated this frame, for memory that is not host coherent.
+    // Call before submitting, followed by Device::flushMappedMemoryRanges().
+    void flush() const;
+
+    template<typename T>
+    T *allocate(std::size_t count, BufferSlice *bufferSlice)
+    {
+        const auto slice = allocate(count * sizeof(T));
+        *bufferSlice = slice.bufferSlice;
+        return static_cast<T *>(slice.data);
+    }
+
+private:
+    const Device *m_device;
+    VkDeviceSize m_frameSize;
+    uint32_t m_frameCount;
+    VkDeviceSize m_minAlignment;
+    std::unique_ptr<Buffer> m_buffer;
+    uint8_t *m_mappedData;
+    VkDeviceSize m_frameStart = 0;
+    VkDeviceSize m_frameOffset = 0;
+};
+
+} // namespace V
@@ -11,14 +11,14 @@ Semaphore::Semaphore(const Device *device)
         .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
     };
 
-    if (vkCreateSemaphore(device->device(), &semaphoreCreateInfo, nullptr, &m_handle) != VK_SUCCESS)
+    if (vkCreateSemaphore(device->device(), &semaphoreCreateInfo, device->allocationCallbacks(), &m_handle) != VK_SUCCESS)
         throw std::runtime_error("Failed to create semaphore");
 }
 
 Semaphore::~Semaphore()
 {
     if (m_handle != VK_NULL_HANDLE)
-        vkDestroySemaphore(m_device->device(), m_handle, nullptr);
+        vkDestroySemaphore(m_device->device(), m_handle, m_device->allocationCallbacks());
 }
 
 } // namespace V
@@ -2,6 +2,7 @@
 
 #include "util.h"
 
+#include <atomic>
 #include <stdexcept>
 
 namespace V {
@@ -10,21 +11,34 @@ ShaderModule::ShaderModule(const Device *device, const char *spvFilePath)
     : m_device(device)
 {
     const auto shaderCode = readFile(spvFilePath);
+    create(reinterpret_cast<const uint32_t *>(shaderCode.data()), shaderCode.size());
+}
+
+ShaderModule::ShaderModule(const Device *device, Span<const uint32_t> code)
+    : m_device(device)
+{
+    create(code.data(), code.size() * sizeof(uint32_t));
+}
+
+void ShaderModule::create(const uint32_t *code, size_t codeSize)
+{
+    static std::atomic<uint64_t> nextId = 1;
+    m_id = nextId++;
 
     VkShaderModuleCreateInfo shaderModuleCreateInfo {
         .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-        .codeSize = shaderCode.size(),
-        .pCode = reinterpret_cast<const uint32_t *>(shaderCode.data())
+        .codeSize = codeSize,
+        .pCode = code
     };
 
-    if (vkCreateShaderModule(device->device(), &shaderModuleCreateInfo, nullptr, &m_handle) != VK_SUCCESS)
+    if (vkCreateShaderModule(m_device->device(), &shaderModuleCreateInfo, m_device->allocationCallbacks(), &m_handle) != VK_SUCCESS)
         throw std::runtime_error("Failed to create shader module");
 }
 
 ShaderModule::~ShaderModule()
 {
     if (m_handle != VK_NULL_HANDLE)
-        vkDestroyShaderModule(m_device->device(), m_handle, nullptr);
+        vkDestroyShaderModule(m_device->device(), m_handle, m_device->allocationCallbacks());
 }
 
 } // namespace V
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "vdevice.h"
+#include "vspan.h"
 
 namespace V {
 
@@ -8,16 +9,23 @@ class ShaderModule : private NonCopyable
 {
 public:
     explicit ShaderModule(const Device *device, const char *spvFilePath);
+    // SPIR-V words, such as the arrays embedded at build time by the add_shaders() CMake rule
+    explicit ShaderModule(const Device *device, Span<const uint32_t> code);
     ~ShaderModule();
 
     const Device *device() const { return m_device; }
     VkDevice deviceHandle() const { return m_device->device(); }
 
     VkShaderModule handle() const { return m_handle; }
+    // unique for the lifetime of the process, unlike the handle which the driver may reuse
+    uint64_t id() const { return m_id; }
 
 private:
+    void create(const uint32_t *code, size_t codeSize);
+
     const Device *m_device;
     VkShaderModule m_handle = VK_NULL_HANDLE;
+    uint64_t m_id;
 };
 
 } // namespace V
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <initializer_list>
+#include <type_traits>
+#include <utility>
+
+namespace V {
+
+// Non-owning view of a contiguous range, for passing arrays into the API without copying them
+// into a std::vector. Converts implicitly from containers with data() and size(), C arrays and
+// braced lists; a span made from a braced list or temporary is only valid for the duration of
+// the call it is passed to.
+template<typename T>
+class Span
+{
+public:
+    using value_type = std::remove_cv_t<T>;
+
+    constexpr Span() = default;
+
+    constexpr Span(T *data, size_t size)
+        : m_data(data)
+        , m_size(size)
+    {
+    }
+
+    template<size_t N>
+    constexpr Span(T (&array)[N])
+        : m_data(array)
+        , m_size(N)
+    {
+    }
+
+    template<typename Container, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Container>, Span> && std::is_convertible_v<decltype(std::declval<Container &>().data()), T *>>>
+    constexpr Span(Container &&container)
+        : m_data(container.data())
+        , m_size(container.size())
+    {
+    }
+
+    template<typename U = T, typename = std::enable_if_t<std::is_const_v<U>>>
+    constexpr Span(std::initializer_list<value_type> list)
+        : Span(list.begin(), list.size())
+    {
+    }
+
+    constexpr T *data() const { return m_data; }
+    constexpr size_t size() const { return m_size; }
+    constexpr bool empty() const { return m_size == 0; }
+
+    constexpr T *begin() const { return m_data; }
+    constexpr T *end() const { return m_data + m_size; }
+    constexpr T &operator[](size_t index) const { return m_data[index]; }
+
+private:
+    T *m_data = nullptr;
+    size_t m_size = 0;
+};
+
+} // namespace V
@@ -0,0 +1,68 @@
+#include "vspecializationconstants.h"
+
+#include "util.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace V {
+
+void SpecializationConstants::setData(uint32_t constantID, const void *data, size_t size)
+{
+    auto it = std::find_if(m_entries.begin(), m_entries.end(), [constantID](const VkSpecializationMapEntry &entry) {
+        return entry.constantID == constantID;
+    });
+    if (it != m_entries.end()) {
+        if (it->size != size)
+            throw std::runtime_error("Specialization constant set again with a different type");
+        std::memcpy(m_data.data() + it->offset, data, size);
+        return;
+    }
+
+    const VkSpecializationMapEntry entry = {
+        .constantID = constantID,
+        .offset = static_cast<uint32_t>(m_data.size()),
+        .size = size
+    };
+    if (m_entries.size() == MaxConstants)
+        throw std::runtime_error("Too many specialization constants");
+    m_entries.push_back(entry);
+    m_data.resize(m_data.size() + size);
+    std::memcpy(m_data.data() + entry.offset, data, size);
+
+    // so that the order of the set() calls does not matter for comparisons
+    std::sort(m_entries.begin(), m_entries.end(), [](const VkSpecializationMapEntry &a, const VkSpecializationMapEntry &b) {
+        return a.constantID < b.constantID;
+    });
+}
+
+VkSpecializationInfo SpecializationConstants::info() const
+{
+    return VkSpecializationInfo {
+        .mapEntryCount = static_cast<uint32_t>(m_entries.size()),
+        .pMapEntries = m_entries.data(),
+        .dataSize = m_data.size(),
+        .pData = m_data.data()
+    };
+}
+
+size_t SpecializationConstants::hash() const
+{
+    size_t seed = 0;
+    for (const auto &entry : m_entries) {
+        hashCombine(seed, entry.constantID);
+        for (size_t i = 0; i < entry.size; ++i)
+            hashCombine(seed, m_data[entry.offset + i]);
+    }
+    return seed;
+}
+
+bool SpecializationConstants::operator==(const SpecializationConstants &other) const
+{
+    return std::equal(m_entries.begin(), m_entries.end(), other.m_entries.begin(), other.m_entries.end(), [this, &other](const VkSpecializationMapEntry &a, const VkSpecializationMapEntry &b) {
+        return a.constantID == b.constantID && a.size == b.size && std::memcmp(m_data.data() + a.offset, other.m_data.data() + b.offset, a.size) == 0;
+    });
+}
+
+} // namespace V
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "vstaticvector.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <type_traits>
+
+namespace V {
+
+// Values for the constant_id specialization constants of a shader stage, applied when the
+// pipeline is created, so one SPIR-V module can be built into several tight variants. bool
+// values are passed as VkBool32, as Vulkan expects.
+class SpecializationConstants
+{
+public:
+    static constexpr size_t MaxConstants = 16;
+
+    template<typename T>
+    SpecializationConstants &set(uint32_t constantID, T value)
+    {
+        static_assert(std::is_arithmetic_v<T> && (sizeof(T) == 4 || sizeof(T) == 8 || std::is_same_v<T, bool>), "specialization constants are bool or 32 or 64 bit scalars");
+        if constexpr (std::is_same_v<T, bool>) {
+            const VkBool32 boolValue = value ? VK_TRUE : VK_FALSE;
+            setData(constantID, &boolValue, sizeof(boolValue));
+        } else {
+            setData(constantID, &value, sizeof(value));
+        }
+        return *this;
+    }
+
+    bool empty() const { return m_entries.empty(); }
+
+    // points into this object, which must outlive the returned structure
+    VkSpecializationInfo info() const;
+
+    size_t hash() const;
+    bool operator==(const SpecializationConstants &other) const;
+    bool operator!=(const SpecializationConstants &other) const { return !(*this == other); }
+
+private:
+    void setData(uint32_t constantID, const void *data, size_t size);
+
+    StaticVector<VkSpecializationMapEntry, MaxConstants> m_entries; // sorted by constant ID
+    StaticVector<uint8_t, MaxConstants * sizeof(uint64_t)> m_data;
+};
+
+} // namespace V
@@ -0,0 +1,159 @@
+#include "vspritebatch.h"
+
+#include "vallocator.h"
+#include "vbuffer.h"
+#include "vcommandbuffer.h"
+#include "vdescriptorpool.h"
+#include "vdescriptorset.h"
+#include "vdescriptorsetlayout.h"
+#include "vringbuffer.h"
+
+#include "util.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace V {
+
+SpriteBatch::Batch::Batch(const Pipeline *pipeline, const DescriptorSet *material)
+    : m_pipeline(pipeline)
+    , m_material(material)
+{
+}
+
+void SpriteBatch::Batch::reserve(size_t count)
+{
+    m_x.reserve(count);
+    m_y.reserve(count);
+    m_width.reserve(count);
+    m_height.reserve(count);
+    m_rotation.reserve(count);
+    m_color.reserve(count);
+}
+
+void SpriteBatch::Batch::clear()
+{
+    m_x.clear();
+    m_y.clear();
+    m_width.clear();
+    m_height.clear();
+    m_rotation.clear();
+    m_color.clear();
+}
+
+SpriteBatch::SpriteBatch(const Device *device, uint32_t frameCount, uint32_t maxSprites)
+    : m_device(device)
+    , m_maxSprites(maxSprites)
+{
+    const VkDeviceSize alignment = m_device->properties().limits.minStorageBufferOffsetAlignment;
+    m_streamSizes = { maxSprites * 4 * sizeof(float), maxSprites * sizeof(float), maxSprites * sizeof(uint32_t) };
+    VkDeviceSize frameSize = 0;
+    for (auto size : m_streamSizes)
+        frameSize += alignUp(size, alignment);
+    m_ringBuffer = std::make_unique<RingBuffer>(m_device, frameSize, frameCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+    m_instanceSetLayout = m_device->descriptorSetLayoutBuilder()
+                                  .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC)
+                                  .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC)
+                                  .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC)
+                                  .create();
+    m_descriptorPool = m_device->descriptorPoolBuilder()
+                               .add(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, StreamCount)
+                               .setMaxSets(1)
+                               .create();
+
+    // a single set for all frames, the dynamic offsets select the frame's slices
+    m_instanceSet = m_descriptorPool->allocateDescriptorSet(m_instanceSetLayout.get());
+    for (uint32_t binding = 0; binding < StreamCount; ++binding)
+        m_instanceSet->writeBuffer(binding, BufferSlice(m_ringBuffer->buffer(), 0, m_streamSizes[binding]));
+}
+
+SpriteBatch::~SpriteBatch() = default;
+
+size_t SpriteBatch::spriteCount() const
+{
+    size_t count = 0;
+    for (const auto &[key, batch] : m_batches)
+        count += batch->size();
+    return count;
+}
+
+void SpriteBatch::beginFrame(uint32_t frameIndex, Fence *fence)
+{
+    m_ringBuffer->beginFrame(frameIndex, fence);
+    for (auto &[key, batch] : m_batches)
+        batch->clear();
+}
+
+SpriteBatch::Batch *SpriteBatch::batch(const Pipeline *pipeline, const DescriptorSet *material)
+{
+    auto &batch = m_batches[{ pipeline, material }];
+    if (!batch)
+        batch.reset(new Batch(pipeline, material));
+    return batch.get();
+}
+
+void SpriteBatch::endFrame()
+{
+    if (spriteCount() > m_maxSprites)
+        throw std::runtime_error("Too many sprites in sprite batch");
+
+    // the slices are as large as the descriptor ranges, but only the written part is flushed
+    std::array<void *, StreamCount> streams;
+    for (size_t i = 0; i < StreamCount; ++i) {
+        const auto slice = m_ringBuffer->allocate(m_streamSizes[i]);
+        streams[i] = slice.data;
+        m_dynamicOffsets[i] = static_cast<uint32_t>(slice.bufferSlice.offset);
+    }
+    float *rects = static_cast<float *>(streams[0]);
+    float *rotations = static_cast<float *>(streams[1]);
+    uint32_t *colors = static_cast<uint32_t *>(streams[2]);
+
+    // batches are laid out back to back in each stream, so a batch is a range of instances
+    uint32_t instance = 0;
+    for (auto &[key, batch] : m_batches) {
+        const size_t count = batch->size();
+        batch->m_firstInstance = instance;
+        if (count == 0)
+            continue;
+
+        // the rects are interleaved from four streams, a loop the compiler can vectorize
+        const float *x = batch->m_x.data();
+        const float *y = batch->m_y.data();
+        const float *width = batch->m_width.data();
+        const float *height = batch->m_height.data();
+        float *rect = rects + 4 * instance;
+        for (size_t i = 0; i < count; ++i) {
+            rect[4 * i + 0] = x[i];
+            rect[4 * i + 1] = y[i];
+            rect[4 * i + 2] = width[i];
+            rect[4 * i + 3] = height[i];
+        }
+        std::memcpy(rotations + instance, batch->m_rotation.data(), count * sizeof(float));
+        std::memcpy(colors + instance, batch->m_color.data(), count * sizeof(uint32_t));
+
+        instance += count;
+    }
+
+    if (instance > 0) {
+        const auto *allocation = m_ringBuffer->buffer()->allocation();
+        allocation->flush(m_dynamicOffsets[0], instance * 4 * sizeof(float));
+        allocation->flush(m_dynamicOffsets[1], instance * sizeof(float));
+        allocation->flush(m_dynamicOffsets[2], instance * sizeof(uint32_t));
+    }
+}
+
+void SpriteBatch::record(const CommandBuffer *commandBuffer, const PipelineLayout *pipelineLayout) const
+{
+    for (const auto &[key, batch] : m_batches) {
+        if (batch->size() == 0)
+            continue;
+        commandBuffer->bindPipeline(batch->m_pipeline);
+        commandBuffer->bindDescriptorSet(pipelineLayout, 0, m_instanceSet.get(), m_dynamicOffsets);
+        if (batch->m_material)
+            commandBuffer->bindDescriptorSet(pipelineLayout, 1, batch->m_material);
+        commandBuffer->draw(6, batch->size(), 0, batch->m_firstInstance);
+    }
+}
+
+} // namespace V
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "vdevice.h"
+
+#include <array>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace V {
+
+class CommandBuffer;
+class DescriptorPool;
+class DescriptorSet;
+class DescriptorSetLayout;
+class Fence;
+class Pipeline;
+class PipelineLayout;
+class RingBuffer;
+
+// Batched 2D sprite renderer using vertex pulling. Sprites are collected per (pipeline, material)
+// batch in structure-of-arrays form, packed once per frame into slices of a RingBuffer and drawn
+// with one instanced draw of 6 vertices per batch, the sprite being gl_InstanceIndex.
+//
+// Pipelines drawing sprites take instanceSetLayout() as set 0, which holds the rects (vec4 of
+// center and size), rotations (float, radians) and colors (packed RGBA8) as dynamic storage
+// buffers at bindings 0 to 2, pointed at the frame's slices by their dynamic offsets. The
+// material set, bound as set 1 when not null, holds textures and the like.
+class SpriteBatch : private NonCopyable
+{
+public:
+    class Batch
+    {
+    public:
+        size_t size() const { return m_x.size(); }
+        void reserve(size_t count);
+
+        void add(float x, float y, float width, float height, float rotation, uint32_t color)
+        {
+            m_x.push_back(x);
+            m_y.push_back(y);
+            m_width.push_back(width);
+            m_height.push_back(height);
+            m_rotation.push_back(rotation);
+            m_color.push_back(color);
+        }
+
+    private:
+        friend class SpriteBatch;
+
+        Batch(const Pipeline *pipeline, const DescriptorSet *material);
+        void clear();
+
+        const Pipeline *m_pipeline;
+        const DescriptorSet *m_material;
+        uint32_t m_firstInstance = 0;
+        std::vector<float> m_x;
+        std::vector<float> m_y;
+        std::vector<float> m_width;
+        std::vector<float> m_height;
+        std::vector<float> m_rotation;
+        std::vector<uint32_t> m_color;
+    };
+
+    explicit SpriteBatch(const Device *device, uint32_t frameCount, uint32_t maxSprites);
+    ~SpriteBatch();
+
+    const DescriptorSetLayout *instanceSetLayout() const { return m_instanceSetLayout.get(); }
+    uint32_t maxSprites() const { return m_maxSprites; }
+    size_t spriteCount() const;
+
+    // Waits for fence, the fence of the submission that last used frameIndex's instance data,
+    // see RingBuffer::beginFrame().
+    void beginFrame(uint32_t frameIndex, Fence *fence);
+
+    // Batches live across frames, so adding to the pointer returned here is the fast path for
+    // many sprites sharing a pipeline and material.
+    Batch *batch(const Pipeline *pipeline, const DescriptorSet *material = nullptr);
+    void add(const Pipeline *pipeline, const DescriptorSet *material, float x, float y, float width, float height, float rotation, uint32_t color)
+    {
+        batch(pipeline, material)->add(x, y, width, height, rotation, color);
+    }
+
+    // Packs the frame's sprites into the ring buffer and queues a flush of them; call
+    // Device::flushMappedMemoryRanges() before submitting.
+    void endFrame();
+
+    void record(const CommandBuffer *commandBuffer, const PipelineLayout *pipelineLayout) const;
+
+private:
+    static constexpr size_t StreamCount = 3; // rects, rotations, colors
+
+    const Device *m_device;
+    uint32_t m_maxSprites;
+    std::array<VkDeviceSize, StreamCount> m_streamSizes; // for maxSprites, the range of the descriptors
+    std::unique_ptr<RingBuffer> m_ringBuffer;
+    std::unique_ptr<DescriptorSetLayout> m_instanceSetLayout;
+    std::unique_ptr<DescriptorPool> m_descriptorPool;
+    std::unique_ptr<DescriptorSet> m_instanceSet;
+    std::array<uint32_t, StreamCount> m_dynamicOffsets = {}; // of the current frame's slices
+    std::map<std::pair<const Pipeline *, const DescriptorSet *>, std::unique_ptr<Batch>> m_batches; // ordered so that batches sharing a pipeline are adjacent
+};
+
+} // namespace V
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+#include <stdexcept>
+
+namespace V {
+
+// A vector with inline storage for up to N elements that never allocates. Meant for the small,
+// bounded arrays of Vulkan structures in builders and on the command recording path; T must be
+// default constructible.
+template<typename T, size_t N>
+class StaticVector
+{
+public:
+    using value_type = T;
+
+    StaticVector() = default;
+
+    StaticVector(std::initializer_list<T> list)
+    {
+        for (const auto &value : list)
+            push_back(value);
+    }
+
+    static constexpr size_t capacity() { return N; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    T *data() { return m_data.data(); }
+    const T *data() const { return m_data.data(); }
+
+    T *begin() { return m_data.data(); }
+    T *end() { return m_data.data() + m_size; }
+    const T *begin() const { return m_data.data(); }
+    const T *end() const { return m_data.data() + m_size; }
+
+    T &operator[](size_t index) { return m_data[index]; }
+    const T &operator[](size_t index) const { return m_data[index]; }
+    T &back() { return m_data[m_size - 1]; }
+    const T &back() const { return m_data[m_size - 1]; }
+
+    void push_back(const T &value)
+    {
+        if (m_size == N)
+            throw std::runtime_error("StaticVector capacity exceeded");
+        m_data[m_size++] = value;
+    }
+
+    void resize(size_t size)
+    {
+        if (size > N)
+            throw std::runtime_error("StaticVector capacity exceeded");
+        std::fill(m_data.begin() + std::min(size, m_size), m_data.begin() + size, T {});
+        m_size = size;
+    }
+
+    void clear() { m_size = 0; }
+
+    template<typename Range>
+    void assign(const Range &range)
+    {
+        clear();
+        for (const auto &value : range)
+            push_back(value);
+    }
+
+    friend bool operator==(const StaticVector &a, const StaticVector &b)
+    {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end());
+    }
+
+private:
+    std::array<T, N> m_data {};
+    size_t m_size = 0;
+};
+
+} // namespace V
@@ -12,7 +12,7 @@ namespace V {
 Surface::Surface(const Device *device, GLFWwindow *window)
     : m_device(device)
 {
-    if (glfwCreateWindowSurface(device->instance(), window, nullptr, &m_handle) != VK_SUCCESS)
+    if (glfwCreateWindowSurface(device->instance(), window, device->allocationCallbacks(), &m_handle) != VK_SUCCESS)
         throw std::runtime_error("Failed to create surface");
 
     VkBool32 presentSupported = VK_FALSE;
@@ -24,7 +24,7 @@ Surface::Surface(const Device *device, GLFWwindow *window)
 Surface::~Surface()
 {
     if (m_handle != VK_NULL_HANDLE)
-        vkDestroySurfaceKHR(m_device->instance(), m_handle, nullptr);
+        vkDestroySurfaceKHR(m_device->instance(), m_handle, m_device->allocationCallbacks());
 }
 
 VkSurfaceCapabilitiesKHR Surface::surfaceCapabilities() const
@@ -10,6 +10,8 @@ namespace V {
 
 Swapchain::Swapchain(const Surface *surface, int width, int height, int backbufferCount)
     : m_surface(surface)
+    , m_requestedWidth(width)
+    , m_requestedHeight(height)
     , m_width(width)
     , m_height(height)
     , m_backbufferCount(backbufferCount)
@@ -25,7 +27,28 @@ Swapchain::~Swapchain()
     cleanup();
 }
 
-void Swapchain::createSwapchain()
+void Swapchain::resize(int width, int height)
+{
+    destroyFramebuffers();
+    destroyImageViews();
+
+    const VkFormat format = m_format;
+    const VkSwapchainKHR oldSwapchain = m_swapchain;
+    m_requestedWidth = width;
+    m_requestedHeight = height;
+    m_suboptimal = false;
+    m_width = width;
+    m_height = height;
+    createSwapchain(oldSwapchain);
+    vkDestroySwapchainKHR(m_surface->deviceHandle(), oldSwapchain, m_surface->device()->allocationCallbacks());
+    if (m_format != format)
+        throw std::runtime_error("Swapchain format changed on resize");
+
+    createImageViews();
+    createFramebuffers();
+}
+
+void Swapchain::createSwapchain(VkSwapchainKHR oldSwapchain)
 {
     const std::vector<VkSurfaceFormatKHR> surfaceFormats = m_surface->surfaceFormats();
 
@@ -39,9 +62,12 @@ void Swapchain::createSwapchain()
 
     const VkSurfaceCapabilitiesKHR surfaceCapabilities = m_surface->surfaceCapabilities();
 
+    // the window may have been resized again since the size was queried, the surface has the final say
     const VkExtent2D swapchainSize = surfaceCapabilities.currentExtent;
-    if (swapchainSize.width != m_width || swapchainSize.height != m_height)
-        throw std::runtime_error("Unexpected current extent?");
+    if (swapchainSize.width != UINT32_MAX) {
+        m_width = swapchainSize.width;
+        m_height = swapchainSize.height;
+    }
 
     if (m_backbufferCount < surfaceCapabilities.minImageCount || (surfaceCapabilities.maxImageCount != 0 && m_backbufferCount > surfaceCapabilities.maxImageCount))
         throw std::runtime_error("Unsupported swapchain backbuffer count?");
@@ -61,7 +87,7 @@ void Swapchain::createSwapchain()
         .minImageCount = static_cast<uint32_t>(m_backbufferCount),
         .imageFormat = m_format,
         .imageColorSpace = colorSpace,
-        .imageExtent = swapchainSize,
+        .imageExtent = VkExtent2D { m_width, m_height },
         .imageArrayLayers = 1,
         .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
         .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
@@ -69,10 +95,10 @@ void Swapchain::createSwapchain()
         .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
         .presentMode = VK_PRESENT_MODE_FIFO_KHR,
         .clipped = VK_TRUE,
-        .oldSwapchain = VK_NULL_HANDLE
+        .oldSwapchain = oldSwapchain
     };
 
-    if (vkCreateSwapchainKHR(m_surface->deviceHandle(), &swapchainCreateInfo, nullptr, &m_swapchain) != VK_SUCCESS)
+    if (vkCreateSwapchainKHR(m_surface->deviceHandle(), &swapchainCreateInfo, m_surface->device()->allocationCallbacks(), &m_swapchain) != VK_SUCCESS)
         throw std::runtime_error("Failed to create swapchain");
 
     // get image handles
@@ -101,7 +127,7 @@ void Swapchain::createImageViews()
                     .layerCount = 1,
             }
         };
-        if (vkCreateImageView(m_surface->deviceHandle(), &imageViewCreateInfo, nullptr, &m_imageViews[i]) != VK_SUCCESS)
+        if (vkCreateImageView(m_surface->deviceHandle(), &imageViewCreateInfo, m_surface->device()->allocationCallbacks(), &m_imageViews[i]) != VK_SUCCESS)
             throw std::runtime_error("Failed to create image view");
     }
 }
@@ -138,8 +164,9 @@ void Swapchain::createRenderPass()
         .pSubpasses = &subpassDescription,
     };
 
-    if (vkCreateRenderPass(m_surface->deviceHandle(), &renderPassCreateInfo, nullptr, &m_renderPass) != VK_SUCCESS)
+    if (vkCreateRenderPass(m_surface->deviceHandle(), &renderPassCreateInfo, m_surface->device()->allocationCallbacks(), &m_renderPass) != VK_SUCCESS)
         throw std::runtime_error("Failed to create render pass");
+    m_renderPassKey = RenderPassKey(renderPassCreateInfo);
 }
 
 void Swapchain::createFramebuffers()
@@ -158,42 +185,65 @@ void Swapchain::createFramebuffers()
             .layers = 1
         };
 
-        if (vkCreateFramebuffer(m_surface->deviceHandle(), &framebufferCreateInfo, nullptr, &m_framebuffers[i]) != VK_SUCCESS)
+        if (vkCreateFramebuffer(m_surface->deviceHandle(), &framebufferCreateInfo, m_surface->device()->allocationCallbacks(), &m_framebuffers[i]) != VK_SUCCESS)
             throw std::runtime_error("Failed to create framebuffer");
     }
 }
 
-void Swapchain::cleanup()
+void Swapchain::destroyImageViews()
+{
+    for (auto imageView : m_imageViews) {
+        if (imageView != VK_NULL_HANDLE)
+            vkDestroyImageView(m_surface->deviceHandle(), imageView, m_surface->device()->allocationCallbacks());
+    }
+    m_imageViews.clear();
+}
+
+void Swapchain::destroyFramebuffers()
 {
     for (auto framebuffer : m_framebuffers) {
         if (framebuffer != VK_NULL_HANDLE)
-            vkDestroyFramebuffer(m_surface->deviceHandle(), framebuffer, nullptr);
+            vkDestroyFramebuffer(m_surface->deviceHandle(), framebuffer, m_surface->device()->allocationCallbacks());
     }
+    m_framebuffers.clear();
+}
+
+void Swapchain::cleanup()
+{
+    destroyFramebuffers();
 
     if (m_renderPass != VK_NULL_HANDLE)
-        vkDestroyRenderPass(m_surface->deviceHandle(), m_renderPass, nullptr);
+        vkDestroyRenderPass(m_surface->deviceHandle(), m_renderPass, m_surface->device()->allocationCallbacks());
 
-    for (auto imageView : m_imageViews) {
-        if (imageView != VK_NULL_HANDLE)
-            vkDestroyImageView(m_surface->deviceHandle(), imageView, nullptr);
-    }
+    destroyImageViews();
 
     if (m_swapchain != VK_NULL_HANDLE)
-        vkDestroySwapchainKHR(m_surface->deviceHandle(), m_swapchain, nullptr);
+        vkDestroySwapchainKHR(m_surface->deviceHandle(), m_swapchain, m_surface->device()->allocationCallbacks());
 }
 
-uint32_t Swapchain::acquireNextImage(Semaphore *semaphore) const
+uint32_t Swapchain::acquireNextImage(Semaphore *semaphore)
 {
-    uint32_t imageIndex;
-    VkResult result = vkAcquireNextImageKHR(m_surface->deviceHandle(), m_swapchain, UINT64_MAX, semaphore->handle(), VK_NULL_HANDLE, &imageIndex);
-    if (result != VK_SUCCESS) {
-        // TODO handle swapchain re-creation
-        throw std::runtime_error("Failed to acquire image");
+    for (;;) {
+        uint32_t imageIndex;
+        VkResult result = vkAcquireNextImageKHR(m_surface->deviceHandle(), m_swapchain, UINT64_MAX, semaphore->handle(), VK_NULL_HANDLE, &imageIndex);
+        switch (result) {
+        case VK_SUCCESS:
+            return imageIndex;
+        case VK_SUBOPTIMAL_KHR:
+            // the image was acquired and the semaphore will be signaled, it can still be presented
+            m_suboptimal = true;
+            return imageIndex;
+        case VK_ERROR_OUT_OF_DATE_KHR:
+            m_surface->device()->waitIdle();
+            resize(m_requestedWidth, m_requestedHeight);
+            break;
+        default:
+            throw std::runtime_error("Failed to acquire image");
+        }
     }
-    return imageIndex;
 }
 
-void Swapchain::queuePresent(uint32_t imageIndex, Semaphore *semaphore) const
+void Swapchain::queuePresent(uint32_t imageIndex, Semaphore *semaphore)
 {
     VkSemaphore semaphoreHandle = semaphore->handle();
     VkPresentInfoKHR presentInfo = {
@@ -205,10 +255,10 @@ void Swapchain::queuePresent(uint32_t imageIndex, Semaphore *semaphore) const
         .pImageIndices = &imageIndex
     };
     VkResult result = vkQueuePresentKHR(m_surface->device()->queue(), &presentInfo);
-    if (result != VK_SUCCESS) {
-        // TODO handle swapchain re-creation
+    if (result == VK_SUBOPTIMAL_KHR || result == VK_ERROR_OUT_OF_DATE_KHR)
+        m_suboptimal = true; // recreated by the next resize(), or by acquireNextImage() once out of date
+    else if (result != VK_SUCCESS)
         throw std::runtime_error("Failed to queue image for presentation");
-    }
 }
 
 } // namespace V
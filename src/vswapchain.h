@@ -1,6 +1,7 @@
 #pragma once
 
 #include "noncopyable.h"
+#include "vrenderpasskey.h"
 
 #include <vulkan/vulkan.h>
 
@@ -26,19 +27,36 @@ public:
     const std::vector<VkImage> &images() const { return m_images; }
     const std::vector<VkImageView> &imageViews() const { return m_imageViews; }
     VkRenderPass renderPass() const { return m_renderPass; }
+    const RenderPassKey &renderPassKey() const { return m_renderPassKey; }
     const std::vector<VkFramebuffer> &framebuffers() const { return m_framebuffers; }
 
-    uint32_t acquireNextImage(Semaphore *signalSemaphore) const;
-    void queuePresent(uint32_t imageIndex, Semaphore *waitSemaphore) const;
+    // Recreates the swapchain, its image views and framebuffers for a new window size, keeping
+    // the render pass and with it every pipeline created for it. Nothing may still use the old
+    // images, wait for the device to be idle first.
+    void resize(int width, int height);
+
+    // True if the window size differs from the one last passed to the constructor or resize(),
+    // or if presentation reported the swapchain as suboptimal. The extent the surface chose may
+    // differ from the window size, so width() and height() are no good for this.
+    bool needsResize(int width, int height) const { return m_suboptimal || width != m_requestedWidth || height != m_requestedHeight; }
+
+    // An out of date swapchain is recreated at the last requested size before acquiring again.
+    uint32_t acquireNextImage(Semaphore *signalSemaphore);
+    void queuePresent(uint32_t imageIndex, Semaphore *waitSemaphore);
 
 private:
-    void createSwapchain();
+    void createSwapchain(VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE);
     void createImageViews();
     void createRenderPass();
     void createFramebuffers();
+    void destroyImageViews();
+    void destroyFramebuffers();
     void cleanup();
 
     const Surface *m_surface;
+    int m_requestedWidth;
+    int m_requestedHeight;
+    bool m_suboptimal = false;
     uint32_t m_width;
     uint32_t m_height;
     uint32_t m_backbufferCount;
@@ -47,6 +65,7 @@ private:
     std::vector<VkImage> m_images;
     std::vector<VkImageView> m_imageViews;
     VkRenderPass m_renderPass = VK_NULL_HANDLE; // XXX probably doesn't belong here
+    RenderPassKey m_renderPassKey;
     std::vector<VkFramebuffer> m_framebuffers; // XXX probably doesn't belong here
 };
 
@@ -0,0 +1,47 @@
+#include "vthreadcommandpools.h"
+
+#include "vcommandbuffer.h"
+#include "vcommandpool.h"
+
+namespace V {
+
+ThreadCommandPools::ThreadCommandPools(const Device *device, uint32_t threadCount, uint32_t frameCount)
+    : ThreadCommandPools(device, threadCount, frameCount, device->queueFamilyIndex())
+{
+}
+
+ThreadCommandPools::ThreadCommandPools(const Device *device, uint32_t threadCount, uint32_t frameCount, uint32_t queueFamilyIndex)
+    : m_device(device)
+    , m_threadCount(threadCount)
+    , m_frameCount(frameCount)
+    , m_threadPools(threadCount * frameCount)
+{
+    for (auto &threadPool : m_threadPools)
+        threadPool.commandPool = m_device->createCommandPool(queueFamilyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+}
+
+ThreadCommandPools::~ThreadCommandPools() = default;
+
+void ThreadCommandPools::beginFrame(uint32_t frameIndex)
+{
+    m_frameIndex = frameIndex % m_frameCount;
+    for (uint32_t i = 0; i < m_threadCount; ++i) {
+        auto &threadPool = m_threadPools[m_frameIndex * m_threadCount + i];
+        if (threadPool.usedCount[0] == 0 && threadPool.usedCount[1] == 0)
+            continue;
+        threadPool.commandPool->reset();
+        threadPool.usedCount[0] = threadPool.usedCount[1] = 0;
+    }
+}
+
+CommandBuffer *ThreadCommandPools::commandBuffer(uint32_t threadIndex, VkCommandBufferLevel level)
+{
+    auto &threadPool = m_threadPools[m_frameIndex * m_threadCount + threadIndex];
+    auto &commandBuffers = threadPool.commandBuffers[level];
+    auto &usedCount = threadPool.usedCount[level];
+    if (usedCount == commandBuffers.size())
+        commandBuffers.push_back(threadPool.commandPool->allocateCommandBuffer(level));
+    return commandBuffers[usedCount++].get();
+}
+
+} // namespace V
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "vdevice.h"
+
+#include <vector>
+
+namespace V {
+
+class CommandBuffer;
+
+// A transient command pool per worker thread and frame in flight, for command buffers that are
+// recorded anew every frame with VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT. Several threads can
+// record in parallel without locking. beginFrame() resets all pools of a frame at once and hands
+// their command buffers out again, so steady state recording allocates nothing.
+class ThreadCommandPools : private NonCopyable
+{
+public:
+    explicit ThreadCommandPools(const Device *device, uint32_t threadCount, uint32_t frameCount);
+    explicit ThreadCommandPools(const Device *device, uint32_t threadCount, uint32_t frameCount, uint32_t queueFamilyIndex);
+    ~ThreadCommandPools();
+
+    uint32_t threadCount() const { return m_threadCount; }
+    uint32_t frameCount() const { return m_frameCount; }
+
+    // The fence of the submission that last used frameIndex's command buffers must have signaled.
+    void beginFrame(uint32_t frameIndex);
+
+    // Returns a command buffer from the current frame's pool for threadIndex, in the initial
+    // state. Only the thread owning threadIndex may call this, different threads concurrently.
+    CommandBuffer *commandBuffer(uint32_t threadIndex, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+private:
+    // aligned so that threads recording at the same time don't share cache lines
+    struct alignas(64) ThreadPool {
+        std::unique_ptr<CommandPool> commandPool;
+        std::vector<std::unique_ptr<CommandBuffer>> commandBuffers[2]; // primary, secondary
+        size_t usedCount[2] = {};
+    };
+
+    const Device *m_device;
+    uint32_t m_threadCount;
+    uint32_t m_frameCount;
+    std::vector<ThreadPool> m_threadPools; // frameIndex * threadCount + threadIndex
+    uint32_t m_frameIndex = 0;
+};
+
+} // namespace V
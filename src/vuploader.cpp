@@ -0,0 +1,260 @@
+#include "vuploader.h"
+
+#include "vallocator.h"
+#include "vbuffer.h"
+#include "vcommandbuffer.h"
+#include "vcommandpool.h"
+#include "vfence.h"
+#include "vsemaphore.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <tuple>
+
+namespace V {
+
+Uploader::Uploader(const Device *device)
+    : m_device(device)
+    , m_transferCommandPool(device->createCommandPool(device->transferQueueFamilyIndex()))
+{
+    if (m_device->hasDedicatedTransferQueue())
+        m_acquireCommandPool = device->createCommandPool();
+}
+
+Uploader::~Uploader()
+{
+    waitIdle();
+}
+
+void Uploader::upload(const Buffer *buffer, VkDeviceSize offset, const void *data, VkDeviceSize size)
+{
+    VkDeviceSize stagingOffset;
+    const Buffer *stagingBuffer = allocateStaging(size, &stagingOffset);
+
+    std::memcpy(stagingBuffer->allocation()->map<char>() + stagingOffset, data, size);
+    stagingBuffer->allocation()->flush(stagingOffset, size);
+
+    // a copy overlapping one of the current generation starts the next one, which is
+    // ordered after it by a barrier
+    const auto next = m_generationRanges.lower_bound({ buffer, offset });
+    bool overlaps = next != m_generationRanges.end() && next->first.first == buffer && next->first.second < offset + size;
+    if (next != m_generationRanges.begin()) {
+        const auto previous = std::prev(next);
+        overlaps = overlaps || (previous->first.first == buffer && previous->second > offset);
+    }
+    if (overlaps) {
+        ++m_generation;
+        m_generationRanges.clear();
+    }
+    m_generationRanges[{ buffer, offset }] = offset + size;
+
+    VkBufferCopy region = {
+        .srcOffset = stagingOffset,
+        .dstOffset = offset,
+        .size = size
+    };
+    m_copies.push_back({ stagingBuffer, buffer, region, m_generation });
+}
+
+const Buffer *Uploader::allocateStaging(VkDeviceSize size, VkDeviceSize *offset)
+{
+    // large uploads get a staging buffer of their own, everything else is packed into chunks
+    if (size > StagingBufferSize) {
+        m_stagingBuffers.push_back(m_device->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryUsage::Upload));
+        *offset = 0;
+        return m_stagingBuffers.back().get();
+    }
+
+    if (m_stagingBuffer && m_stagingOffset + size > StagingBufferSize)
+        m_stagingBuffers.push_back(std::move(m_stagingBuffer));
+
+    if (!m_stagingBuffer) {
+        if (!m_freeStagingBuffers.empty()) {
+            m_stagingBuffer = std::move(m_freeStagingBuffers.back());
+            m_freeStagingBuffers.pop_back();
+        } else {
+            m_stagingBuffer = m_device->createBuffer(StagingBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryUsage::Upload);
+        }
+        m_stagingOffset = 0;
+    }
+
+    *offset = m_stagingOffset;
+    m_stagingOffset += size;
+    return m_stagingBuffer.get();
+}
+
+std::vector<Uploader::Copy> Uploader::coalesceCopies()
+{
+    // generations stay in upload order, the stable sort keeps equal keys in upload order too
+    std::stable_sort(m_copies.begin(), m_copies.end(), [](const Copy &a, const Copy &b) {
+        return std::tie(a.generation, a.dstBuffer, a.srcBuffer, a.region.dstOffset) < std::tie(b.generation, b.dstBuffer, b.srcBuffer, b.region.dstOffset);
+    });
+
+    // merge copies that are contiguous in both the staging and the destination buffer
+    std::vector<Copy> copies;
+    for (const auto &copy : m_copies) {
+        if (!copies.empty()) {
+            auto &last = copies.back();
+            if (last.generation == copy.generation && last.srcBuffer == copy.srcBuffer && last.dstBuffer == copy.dstBuffer && last.region.srcOffset + last.region.size == copy.region.srcOffset && last.region.dstOffset + last.region.size == copy.region.dstOffset) {
+                last.region.size += copy.region.size;
+                continue;
+            }
+        }
+        copies.push_back(copy);
+    }
+    m_copies.clear();
+    m_generation = 0;
+    m_generationRanges.clear();
+    return copies;
+}
+
+UploadToken Uploader::submit()
+{
+    retireBatches();
+
+    if (m_copies.empty())
+        return m_lastToken;
+
+    m_device->flushMappedMemoryRanges();
+
+    const auto copies = coalesceCopies();
+    const bool transferOwnership = m_device->hasDedicatedTransferQueue();
+
+    Batch batch;
+    batch.token = ++m_lastToken;
+    batch.fence = m_device->createFence();
+
+    batch.transferCommandBuffer = m_transferCommandPool->allocateCommandBuffer();
+    batch.transferCommandBuffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+    // one vkCmdCopyBuffer per (staging buffer, destination buffer) pair and generation, with a
+    // barrier between generations as their destinations overlap
+    std::vector<VkBufferCopy> regions;
+    for (auto it = copies.begin(); it != copies.end();) {
+        if (it != copies.begin() && it->generation != std::prev(it)->generation)
+            batch.transferCommandBuffer->memoryBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+        auto end = std::find_if(it, copies.end(), [it](const Copy &copy) {
+            return copy.generation != it->generation || copy.srcBuffer != it->srcBuffer || copy.dstBuffer != it->dstBuffer;
+        });
+        regions.clear();
+        std::transform(it, end, std::back_inserter(regions), [](const Copy &copy) { return copy.region; });
+        batch.transferCommandBuffer->copyBuffer(it->srcBuffer, it->dstBuffer, regions);
+        it = end;
+    }
+
+    if (transferOwnership) {
+        // release the written ranges on the transfer queue and acquire them on the graphics queue
+        std::vector<VkBufferMemoryBarrier> barriers;
+        for (const auto &copy : copies) {
+            VkBufferMemoryBarrier barrier = {
+                .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = 0,
+                .srcQueueFamilyIndex = m_device->transferQueueFamilyIndex(),
+                .dstQueueFamilyIndex = m_device->queueFamilyIndex(),
+                .buffer = copy.dstBuffer->handle(),
+                .offset = copy.region.dstOffset,
+                .size = copy.region.size
+            };
+            barriers.push_back(barrier);
+        }
+        batch.transferCommandBuffer->bufferMemoryBarriers(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, barriers);
+
+        for (auto &barrier : barriers) {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        }
+        batch.acquireCommandBuffer = m_acquireCommandPool->allocateCommandBuffer();
+        batch.acquireCommandBuffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        batch.acquireCommandBuffer->bufferMemoryBarriers(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, barriers);
+        batch.acquireCommandBuffer->end();
+    } else {
+        // make the copies visible to anything that may read the buffers in later submissions
+        batch.transferCommandBuffer->memoryBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_READ_BIT);
+    }
+    batch.transferCommandBuffer->end();
+
+    const VkCommandBuffer transferCommandBufferHandle = batch.transferCommandBuffer->handle();
+    if (transferOwnership) {
+        batch.semaphore = m_device->createSemaphore();
+        const VkSemaphore semaphoreHandle = batch.semaphore->handle();
+
+        VkSubmitInfo transferSubmitInfo = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &transferCommandBufferHandle,
+            .signalSemaphoreCount = 1,
+            .pSignalSemaphores = &semaphoreHandle
+        };
+        if (vkQueueSubmit(m_device->transferQueue(), 1, &transferSubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+            throw std::runtime_error("Failed to submit upload command");
+
+        const VkCommandBuffer acquireCommandBufferHandle = batch.acquireCommandBuffer->handle();
+        const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        VkSubmitInfo acquireSubmitInfo = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .waitSemaphoreCount = 1,
+            .pWaitSemaphores = &semaphoreHandle,
+            .pWaitDstStageMask = &waitStage,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &acquireCommandBufferHandle
+        };
+        if (vkQueueSubmit(m_device->queue(), 1, &acquireSubmitInfo, batch.fence->handle()) != VK_SUCCESS)
+            throw std::runtime_error("Failed to submit upload acquire command");
+    } else {
+        VkSubmitInfo submitInfo = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &transferCommandBufferHandle
+        };
+        if (vkQueueSubmit(m_device->queue(), 1, &submitInfo, batch.fence->handle()) != VK_SUCCESS)
+            throw std::runtime_error("Failed to submit upload command");
+    }
+
+    // the staging memory stays alive until the batch has completed
+    batch.stagingBuffers = std::move(m_stagingBuffers);
+    m_stagingBuffers.clear();
+    if (m_stagingBuffer)
+        batch.stagingBuffers.push_back(std::move(m_stagingBuffer));
+
+    m_batches.push_back(std::move(batch));
+    return m_lastToken;
+}
+
+bool Uploader::isComplete(UploadToken token)
+{
+    retireBatches();
+    return token <= m_completedToken;
+}
+
+void Uploader::wait(UploadToken token)
+{
+    for (auto &batch : m_batches) {
+        if (batch.token > token)
+            break;
+        batch.fence->wait();
+    }
+    retireBatches();
+}
+
+void Uploader::waitIdle()
+{
+    wait(m_lastToken);
+}
+
+void Uploader::retireBatches()
+{
+    while (!m_batches.empty() && m_batches.front().fence->isSignaled()) {
+        auto &batch = m_batches.front();
+        m_completedToken = batch.token;
+        for (auto &stagingBuffer : batch.stagingBuffers) {
+            if (stagingBuffer->size() == StagingBufferSize)
+                m_freeStagingBuffers.push_back(std::move(stagingBuffer));
+        }
+        m_batches.pop_front();
+    }
+}
+
+} // namespace V
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "vdevice.h"
+
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace V {
+
+class CommandBuffer;
+
+using UploadToken = uint64_t;
+
+// Copies data into (typically device local) buffers through host visible staging buffers.
+// Uploads are batched until submit(), which coalesces the pending copies into as few copy
+// regions as possible and submits them without waiting. When the device has a dedicated
+// transfer queue the copies run there and ownership of the written ranges is handed over to
+// the graphics queue family, so streaming uploads can overlap rendering. The token returned
+// by submit() can be polled with isComplete() or waited on with wait(). Uploads that overlap
+// an earlier pending upload to the same buffer are applied after it, in the order given.
+//
+// The destination ranges must not be in use by the GPU while an upload to them is in flight.
+class Uploader : private NonCopyable
+{
+public:
+    static constexpr VkDeviceSize StagingBufferSize = 4 * 1024 * 1024;
+
+    explicit Uploader(const Device *device);
+    ~Uploader();
+
+    void upload(const Buffer *buffer, VkDeviceSize offset, const void *data, VkDeviceSize size);
+    UploadToken submit();
+
+    bool isComplete(UploadToken token);
+    void wait(UploadToken token);
+    void waitIdle();
+
+private:
+    struct Copy {
+        const Buffer *srcBuffer;
+        const Buffer *dstBuffer;
+        VkBufferCopy region;
+        uint32_t generation; // copies of one generation have disjoint destinations
+    };
+
+    struct Batch {
+        UploadToken token;
+        std::unique_ptr<CommandBuffer> transferCommandBuffer;
+        std::unique_ptr<CommandBuffer> acquireCommandBuffer;
+        std::unique_ptr<Semaphore> semaphore;
+        std::unique_ptr<Fence> fence;
+        std::vector<std::unique_ptr<Buffer>> stagingBuffers;
+    };
+
+    const Buffer *allocateStaging(VkDeviceSize size, VkDeviceSize *offset);
+    std::vector<Copy> coalesceCopies();
+    void retireBatches();
+
+    const Device *m_device;
+    std::unique_ptr<CommandPool> m_transferCommandPool;
+    std::unique_ptr<CommandPool> m_acquireCommandPool;
+    std::unique_ptr<Buffer> m_stagingBuffer; // chunk the pending copies are being packed into
+    VkDeviceSize m_stagingOffset = 0;
+    std::vector<std::unique_ptr<Buffer>> m_stagingBuffers; // filled chunks and oversized buffers used by the pending copies
+    std::vector<std::unique_ptr<Buffer>> m_freeStagingBuffers;
+    std::vector<Copy> m_copies;
+    uint32_t m_generation = 0;
+    std::map<std::pair<const Buffer *, VkDeviceSize>, VkDeviceSize> m_generationRanges; // destination ranges written by the current generation, (buffer, offset) -> end
+    std::deque<Batch> m_batches;
+    UploadToken m_lastToken = 0;
+    UploadToken m_completedToken = 0;
+};
+
+} // namespace V